@@ -0,0 +1,204 @@
+/* allocbench.cpp */
+#include "wrapper.h"
+#include <boost/current_function.hpp>
+#include <iostream>
+#include <chrono>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <string>
+#include <new>
+#include <cstdlib>
+#include <cstdio>
+
+// Counts the heap allocations of a Connection in steady state. Two
+// connections on one Hive bounce a message over loopback; every round trip
+// completes two sends, two receives and the posts to their strands. The
+// replaced global operator new counts every allocation made while the
+// measurement window is open, after a warmup during which the queues, the
+// buffer pool and the handler memory reach their working set.
+//
+// usage: allocbench [seconds] [message bytes]
+
+using Clock = std::chrono::steady_clock;
+
+std::atomic<uint64_t> allocations{0};
+
+// Kept out of line: once inlined, GCC sees free called on memory from
+// operator new and warns with -Wmismatched-new-delete.
+__attribute__((noinline)) void *operator new(size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *pointer = std::malloc(size ? size : 1))
+        return pointer;
+    throw std::bad_alloc();
+}
+
+__attribute__((noinline)) void operator delete(void *pointer) noexcept
+{
+    std::free(pointer);
+}
+
+__attribute__((noinline)) void operator delete(void *pointer, size_t size) noexcept
+{
+    std::free(pointer);
+}
+
+class PingConnection : public Connection
+{
+public:
+    PingConnection(std::shared_ptr<Hive> hive, size_t message_size, std::atomic<uint64_t> *round_trips) :
+        Connection(hive),
+        m_message_size(message_size),
+        m_round_trips(round_trips)
+    {
+    }
+
+    ~PingConnection() override = default;
+
+private:
+    void OnAccept(const std::string &host, uint16_t port) override
+    {
+        Recv();
+    }
+
+    void OnConnect(const std::string &host, uint16_t port) override
+    {
+        Recv();
+        auto buffer = GetHive()->GetBufferPool().Acquire(m_message_size);
+        buffer.resize(m_message_size, 'x');
+        Send(std::move(buffer));
+    }
+
+    void OnSend(const std::vector<uint8_t> &buffer) override
+    {
+    }
+
+    void OnRecv(std::vector<uint8_t> &buffer) override
+    {
+        if (m_round_trips)
+            m_round_trips->fetch_add(1, std::memory_order_relaxed);
+
+        // Bounce the bytes back, the buffer pool replaces the receive buffer
+        Send(std::move(buffer));
+        if (!IsContinuousRecv())
+            Recv();
+    }
+
+    void OnTimer(const boost::posix_time::time_duration &delta) override
+    {
+    }
+
+    void OnError(const boost::system::error_code &error) override
+    {
+    }
+
+private:
+    size_t m_message_size;
+    std::atomic<uint64_t> *m_round_trips;
+};
+
+class PingAcceptor : public Acceptor
+{
+public:
+    PingAcceptor(std::shared_ptr<Hive> hive, size_t message_size, bool continuous) :
+        Acceptor(hive),
+        m_message_size(message_size),
+        m_continuous(continuous)
+    {}
+
+    ~PingAcceptor() override = default;
+
+    std::shared_ptr<Connection> m_accepted;
+
+private:
+    std::shared_ptr<Connection> CreateConnection() override
+    {
+        auto connection = std::make_shared<PingConnection>(GetHive(), m_message_size, nullptr);
+        connection->SetContinuousRecv(m_continuous);
+        return connection;
+    }
+
+    bool OnAccept(
+        std::shared_ptr<Connection> connection,
+        const std::string &host,
+        uint16_t port
+    ) override
+    {
+        m_accepted = connection;
+        return true;
+    }
+
+    void OnTimer(const boost::posix_time::time_duration &delta) override
+    {
+    }
+
+    void OnError(const boost::system::error_code &error) override
+    {
+    }
+
+private:
+    size_t m_message_size;
+    bool m_continuous;
+};
+
+struct Result
+{
+    uint64_t m_round_trips;
+    uint64_t m_allocations;
+};
+
+Result Bench(size_t seconds, size_t message_size, bool continuous)
+{
+    auto hive = std::make_shared<Hive>(1);
+    auto acceptor = std::make_shared<PingAcceptor>(hive, message_size, continuous);
+    acceptor->SetPendingAccepts(1);
+    acceptor->Listen("127.0.0.1", 0);
+    acceptor->Accept();
+    std::thread runner([hive]() { hive->Run(); });
+
+    std::atomic<uint64_t> round_trips{0};
+    auto client = std::make_shared<PingConnection>(hive, message_size, &round_trips);
+    client->SetContinuousRecv(continuous);
+    client->Connect("127.0.0.1", acceptor->GetAcceptor().local_endpoint().port());
+
+    // The warmup spans more than one timer interval, so that the timers of
+    // the connections have expired once as well
+    std::this_thread::sleep_for(std::chrono::seconds(2));
+    uint64_t first_round_trip = round_trips.load();
+    uint64_t first_allocation = allocations.load();
+    std::this_thread::sleep_for(std::chrono::seconds(seconds));
+    Result result{round_trips.load() - first_round_trip, allocations.load() - first_allocation};
+
+    client->Disconnect();
+    acceptor->Stop();
+    hive->Stop();
+    runner.join();
+    return result;
+}
+
+int main(int argc, char *argv[])
+{
+    size_t seconds = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 3;
+    size_t message_size = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 64;
+
+    std::cout << BOOST_CURRENT_FUNCTION << ' ' << seconds << " s, "
+              << message_size << " byte messages\n\n";
+
+    auto report = [](const char *name, const Result &result)
+    {
+        char line[160];
+        std::snprintf(
+            line, sizeof(line), "%-24s %10llu round trips %8llu allocations %10.6f per round trip\n",
+            name, static_cast<unsigned long long>(result.m_round_trips),
+            static_cast<unsigned long long>(result.m_allocations),
+            result.m_round_trips ? double(result.m_allocations) / result.m_round_trips : 0.0
+        );
+        std::cout << line << std::flush;
+    };
+
+    report("Recv per OnRecv", Bench(seconds, message_size, false));
+    report("continuous", Bench(seconds, message_size, true));
+
+    return 0;
+}
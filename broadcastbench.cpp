@@ -0,0 +1,297 @@
+/* broadcastbench.cpp */
+#include "wrapper.h"
+#include <boost/current_function.hpp>
+#include <iostream>
+#include <chrono>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <string>
+#include <cstdlib>
+#include <cstdio>
+
+// Compares the ways a server can fan a message out to its subscribers:
+// calling Send with the same vector for every member, which copies the
+// payload per member, calling Send with one SharedBuffer, and
+// ConnectionGroup::Broadcast, which also shares the payload and posts once
+// per Hive instead of once per member.
+//
+// The subscribers are client connections on their own HivePool that count
+// the bytes they receive. The publish column is the time the publishing
+// thread spends handing the messages over, the delivered column the time
+// until every subscriber has received every message.
+//
+// usage: broadcastbench [members] [messages] [payload bytes] [threads]
+
+using Clock = std::chrono::steady_clock;
+
+class Subscriber : public Connection
+{
+public:
+    Subscriber(std::shared_ptr<Hive> hive, std::atomic<uint64_t> &received) :
+        Connection(hive),
+        m_received(received)
+    {
+        SetReceiveBufferSize(64 * 1024);
+    }
+
+    ~Subscriber() override = default;
+
+private:
+    void OnAccept(const std::string &host, uint16_t port) override
+    {
+    }
+
+    void OnConnect(const std::string &host, uint16_t port) override
+    {
+        Recv();
+    }
+
+    void OnSend(const std::vector<uint8_t> &buffer) override
+    {
+    }
+
+    void OnRecv(std::vector<uint8_t> &buffer) override
+    {
+        m_received.fetch_add(buffer.size(), std::memory_order_relaxed);
+        Recv();
+    }
+
+    void OnTimer(const boost::posix_time::time_duration &delta) override
+    {
+    }
+
+    void OnError(const boost::system::error_code &error) override
+    {
+    }
+
+private:
+    std::atomic<uint64_t> &m_received;
+};
+
+class Member : public Connection
+{
+public:
+    Member(std::shared_ptr<Hive> hive) :
+        Connection(hive)
+    {
+    }
+
+    ~Member() override = default;
+
+private:
+    void OnAccept(const std::string &host, uint16_t port) override
+    {
+    }
+
+    void OnConnect(const std::string &host, uint16_t port) override
+    {
+    }
+
+    void OnSend(const std::vector<uint8_t> &buffer) override
+    {
+    }
+
+    void OnRecv(std::vector<uint8_t> &buffer) override
+    {
+    }
+
+    void OnTimer(const boost::posix_time::time_duration &delta) override
+    {
+    }
+
+    void OnError(const boost::system::error_code &error) override
+    {
+    }
+};
+
+class MemberAcceptor : public Acceptor
+{
+public:
+    MemberAcceptor(
+        std::shared_ptr<Hive> hive,
+        std::mutex &mutex,
+        std::vector<std::shared_ptr<Connection> > &members
+    ) :
+        Acceptor(hive),
+        m_mutex(mutex),
+        m_members(members)
+    {}
+
+    ~MemberAcceptor() override = default;
+
+private:
+    std::shared_ptr<Connection> CreateConnection() override
+    {
+        return std::make_shared<Member>(GetHive());
+    }
+
+    bool OnAccept(
+        std::shared_ptr<Connection> connection,
+        const std::string &host,
+        uint16_t port
+    ) override
+    {
+        std::lock_guard lck(m_mutex);
+        m_members.emplace_back(std::move(connection));
+        return true;
+    }
+
+    void OnTimer(const boost::posix_time::time_duration &delta) override
+    {
+    }
+
+    void OnError(const boost::system::error_code &error) override
+    {
+    }
+
+private:
+    std::mutex &m_mutex;
+    std::vector<std::shared_ptr<Connection> > &m_members;
+};
+
+struct Result
+{
+    double m_publish;
+    double m_delivered;
+    bool m_complete;
+};
+
+// Runs publish, then waits until the subscribers have received expected
+// bytes in total.
+template<class Publish>
+Result Bench(std::atomic<uint64_t> &received, uint64_t expected, Publish publish)
+{
+    received = 0;
+    auto start = Clock::now();
+    publish();
+    auto published = Clock::now();
+    auto deadline = published + std::chrono::seconds(60);
+    while (received.load(std::memory_order_relaxed) < expected && Clock::now() < deadline)
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    auto delivered = Clock::now();
+    return Result{
+        std::chrono::duration<double, std::milli>(published - start).count(),
+        std::chrono::duration<double, std::milli>(delivered - start).count(),
+        received.load() >= expected
+    };
+}
+
+int main(int argc, char *argv[])
+{
+    size_t members_count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000;
+    size_t messages = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 100;
+    size_t payload_size = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 1024;
+    size_t threads = argc > 4 ? std::strtoull(argv[4], nullptr, 10) : 0;
+
+    HivePool server_pool(threads);
+    std::mutex mutex;
+    std::vector<std::shared_ptr<Connection> > members;
+    std::vector<std::shared_ptr<MemberAcceptor> > acceptors;
+    uint16_t port = 0;
+    for (size_t i = 0; i != server_pool.GetSize(); ++i)
+    {
+        auto acceptor = std::make_shared<MemberAcceptor>(server_pool.GetHive(i), mutex, members);
+        acceptor->SetReusePort(true);
+        acceptor->Listen("127.0.0.1", port);
+        acceptor->Accept();
+        port = acceptor->GetAcceptor().local_endpoint().port();
+        acceptors.emplace_back(std::move(acceptor));
+    }
+    server_pool.Run();
+
+    HivePool client_pool(threads);
+    std::atomic<uint64_t> received{0};
+    std::vector<std::shared_ptr<Subscriber> > subscribers;
+    for (size_t i = 0; i != members_count; ++i)
+    {
+        auto subscriber = std::make_shared<Subscriber>(client_pool.GetNextHive(), received);
+        subscriber->Connect("127.0.0.1", port);
+        subscribers.emplace_back(std::move(subscriber));
+    }
+    client_pool.Run();
+
+    auto deadline = Clock::now() + std::chrono::seconds(10);
+    while (Clock::now() < deadline)
+    {
+        std::lock_guard lck(mutex);
+        if (members.size() == members_count)
+            break;
+    }
+
+    std::lock_guard lck(mutex);
+    ConnectionGroup group;
+    for (auto &&member : members)
+        group.Add(member);
+
+    std::cout << BOOST_CURRENT_FUNCTION << ' ' << members.size() << " members, "
+              << messages << " messages of " << payload_size << " bytes, "
+              << server_pool.GetSize() << " server threads\n\n";
+
+    std::vector<uint8_t> payload(payload_size, 'x');
+    uint64_t expected = static_cast<uint64_t>(members.size()) * messages * payload_size;
+
+    auto report = [messages,&members](const char *name, const Result &result)
+    {
+        char line[160];
+        std::snprintf(
+            line, sizeof(line), "%-30s publish %9.2f ms %8.1f ns/send   delivered %9.2f ms%s\n",
+            name, result.m_publish, result.m_publish * 1e6 / (messages * members.size()),
+            result.m_delivered, result.m_complete ? "" : " (incomplete)"
+        );
+        std::cout << line << std::flush;
+    };
+
+    report(
+        "Send copy per member",
+        Bench(
+            received, expected,
+            [&]()
+            {
+                for (size_t i = 0; i != messages; ++i)
+                    for (auto &&member : members)
+                        member->Send(payload);
+            }
+        )
+    );
+
+    report(
+        "Send SharedBuffer per member",
+        Bench(
+            received, expected,
+            [&]()
+            {
+                for (size_t i = 0; i != messages; ++i)
+                {
+                    auto buffer = std::make_shared<const std::vector<uint8_t> >(payload);
+                    for (auto &&member : members)
+                        member->Send(buffer);
+                }
+            }
+        )
+    );
+
+    report(
+        "ConnectionGroup::Broadcast",
+        Bench(
+            received, expected,
+            [&]()
+            {
+                for (size_t i = 0; i != messages; ++i)
+                    group.Broadcast(payload);
+            }
+        )
+    );
+
+    group.Clear();
+    for (auto &&subscriber : subscribers)
+        subscriber->Disconnect();
+    for (auto &&member : members)
+        member->Disconnect();
+    for (auto &&acceptor : acceptors)
+        acceptor->Stop();
+    client_pool.Stop();
+    server_pool.Stop();
+
+    return 0;
+}
@@ -1,169 +1,77 @@
 /* clienthttpget.cpp */
 #include "wrapper.h"
+#include "logger.h"
+#include "http.h"
 #include <boost/current_function.hpp>
 #include <iostream>
-#include <mutex>
 #include <thread>
 #include <algorithm>
 #include <type_traits>
 
-std::mutex global_stream_lock;
-
-class MyConnection : public Connection
-{
-public:
-    MyConnection(std::shared_ptr<Hive> hive) :
-        Connection(hive) 
-    {
-    }
-
-    ~MyConnection() override = default;
-
-private:
-    void OnAccept(const std::string &host, uint16_t port) override
-    {
-        {
-            std::lock_guard lck(global_stream_lock);
-            std::cout << "Thread#" << std::this_thread::get_id() << ' '
-                      << BOOST_CURRENT_FUNCTION
-                      << ' ' << host << ':' << port << '\n';
-        }
-
-        Recv();
-    }
-
-    void OnConnect(const std::string &host, uint16_t port) override
-    {
-        {
-            std::lock_guard lck(global_stream_lock);
-            std::cout << "Thread#" << std::this_thread::get_id() << ' '
-                      << BOOST_CURRENT_FUNCTION
-                      << ' ' << host << ':' << port << '\n';
-        }
-
-        Recv();
-
-	std::string_view str_v = "GET / HTTP/1.0\r\n\r\n";
-	std::vector<uint8_t> request(str_v.begin(), str_v.end());
-	Send(std::move(request));
-    }
-
-    void OnSend(const std::vector<uint8_t> &buffer) override
-    {
-        std::lock_guard lck(global_stream_lock);
-        std::cout << "Thread#" << std::this_thread::get_id() << ' '
-                  << BOOST_CURRENT_FUNCTION
-                  << ' ' << buffer.size() << " bytes to "
-                  << GetSocket().remote_endpoint() << ": ";
-
-        for (size_t x = 0; x < buffer.size(); ++x)
-        {
-            if (isprint(buffer[x]) && !iscntrl(buffer[x]))
-                std::cout  << buffer[x] << ' ';
-            else
-                std::cout << std::hex << "0x" << (int)buffer[x] << ' ';
-
-            if (x && (x) % 16 == 0)
-                std::cout << '\n';
-        }
-
-        std::cout << std::endl;
-    }
-
-    void OnRecv(std::vector<uint8_t> &buffer) override
-    {
-        {
-            std::lock_guard lck(global_stream_lock);
-            std::cout << "Thread#" << std::this_thread::get_id() << ' '
-                      << BOOST_CURRENT_FUNCTION
-                      << ' ' << buffer.size() << " bytes from "
-                      << GetSocket().remote_endpoint() << ": ";
-
-            for (size_t x = 0; x < buffer.size(); ++x)
-            {
-                if (isprint(buffer[x]) && !iscntrl(buffer[x]))
-                    std::cout  << buffer[x] << ' ';
-                else
-                    std::cout << std::hex << "0x" << (int)buffer[x] << ' ';
-
-                if (x && (x) % 16 == 0)
-                    std::cout << '\n';
-            }
-
-            std::cout << std::endl;
-        }
-
-        // Start the next receive
-        Recv();
-    }
-
-    void OnTimer(const boost::posix_time::time_duration &delta) override
-    {
-        std::lock_guard lck(global_stream_lock);
-        std::cout << "Thread#" << std::this_thread::get_id() << ' '
-                  << BOOST_CURRENT_FUNCTION << ' '
-		  << GetSocket().remote_endpoint()
-                  << ' ' << delta << '\n';
-    }
-
-    void OnError(const boost::system::error_code &error) override
-    {
-        std::lock_guard lck(global_stream_lock);
-	std::cout << std::flush;
-        std::cout << "Thread#" << std::this_thread::get_id() << ' '
-                  << BOOST_CURRENT_FUNCTION 
-                  << ' ' << error << '\n' << std::flush;
-    }
-};
-
-void WorkerThread(boost::asio::io_context &ioctx, size_t counter)
+void WorkerThread(std::shared_ptr<Hive> hive, size_t counter)
 {
-    {
-        std::lock_guard lck(global_stream_lock);
-        std::cout << "Thread#" << std::this_thread::get_id() << ' '
-                  << BOOST_CURRENT_FUNCTION << ' '
-                  << counter << " Start.\n";
-    }
+    Log(BOOST_CURRENT_FUNCTION, ' ', counter, " Start.");
 
     while (true)
     {
         try
         {
-            boost::system::error_code ec;
-            ioctx.run(ec);
-            if (ec)
-            {
-                std::lock_guard lck(global_stream_lock);
-                std::cout << "Thread#" << std::this_thread::get_id() << ' '
-                          << BOOST_CURRENT_FUNCTION
-                          << " Error message: " << ec << ".\n";
-            }
+            // Hive::Run also refreshes the Hive's cached clock
+            hive->Run();
             break;
         }
         catch (std::exception &e)
         {
-            std::lock_guard lck(global_stream_lock);
-            std::cout << "Thread#" << std::this_thread::get_id() << ' '
-                      << BOOST_CURRENT_FUNCTION
-                      << " Exception message: " << e.what() << ".\n";
+            Log(BOOST_CURRENT_FUNCTION, " Exception message: ", e.what(), '.');
         }
     }
 
-    std::lock_guard lck(global_stream_lock);
-    std::cout << "Thread#" << std::this_thread::get_id() << ' '
-              << BOOST_CURRENT_FUNCTION << ' '
-              << counter << " End.\n";
+    Log(BOOST_CURRENT_FUNCTION, ' ', counter, " End.");
 }
 
 int main()
 {
-    std::cout << "Thread#" << std::this_thread::get_id() << ' '
-              << BOOST_CURRENT_FUNCTION
-              << " Press ENTER to exit!\n";
+    Log(BOOST_CURRENT_FUNCTION, " Press ENTER to exit!");
 
     auto hive = std::make_shared<Hive>();
-    auto connection = std::make_shared<MyConnection>(hive);
-    connection->Connect("www.packtpub.com", 80);
+    auto client = std::make_shared<HttpClient>(hive);
+
+    // One connection per host, so both requests share one persistent
+    // HTTP/1.1 connection
+    client->SetMaxConnectionsPerHost(1);
+    for (auto &&target : {"/", "/robots.txt"})
+    {
+        client->Get(
+            "www.packtpub.com",
+            80,
+            target,
+            [target=std::string(target)](
+                const boost::system::error_code &error,
+                const HttpResponse &response
+            )
+            {
+                if (error)
+                {
+                    Log(BOOST_CURRENT_FUNCTION, ' ', target, ' ', error);
+                    return;
+                }
+
+                Log(
+                    BOOST_CURRENT_FUNCTION, ' ', target, " HTTP/1.", response.m_version_minor,
+                    ' ', response.m_status, ' ', response.m_reason
+                );
+                for (auto &&header : response.m_headers)
+                    Log(BOOST_CURRENT_FUNCTION, ' ', header.m_name, ": ", header.m_value);
+                Log(
+                    BOOST_CURRENT_FUNCTION, ' ', response.m_body.size(), " bytes: ",
+                    LogHex(
+                        reinterpret_cast<const uint8_t *>(response.m_body.data()),
+                        response.m_body.size()
+                    )
+                );
+            }
+        );
+    }
 
     auto threads_count = std::thread::hardware_concurrency();
     std::vector<std::thread> threads(threads_count);
@@ -173,16 +81,17 @@ int main()
             threads.cbegin(),
             threads.cend(),
             threads.begin(),
-            [&n=i,&io=hive->GetContext()](auto &&th)
+            [&n=i,&hive](auto &&th)
             {
                 ++n;
-                return std::decay_t<decltype(th)>(&WorkerThread, std::ref(io), n);
+                return std::decay_t<decltype(th)>(&WorkerThread, hive, n);
             }
         );
     }
-    
+
     std::cin.get();
 
+    client->Close();
     hive->Stop();
 
     for (auto &&th : threads)
@@ -190,10 +99,8 @@ int main()
         if (th.joinable())
             th.join();
     }
-    
-    std::cout << "Thread#" << std::this_thread::get_id() << ' '
-              << BOOST_CURRENT_FUNCTION
-              << " Exit caused by press ENTER!\n";
+
+    Log(BOOST_CURRENT_FUNCTION, " Exit caused by press ENTER!");
 
     return 0;
 }
@@ -0,0 +1,199 @@
+/* coroecho.cpp */
+#include "wrapper.h"
+#include "logger.h"
+#include <boost/current_function.hpp>
+#include <iostream>
+#include <thread>
+#include <future>
+#include <string>
+
+// Drives a client Connection with the coroutine interface against an
+// in-process echo server that uses the callbacks. The coroutine runs on the
+// strand of the connection, connects with AsyncConnect, writes a message
+// with Write and reads the echo back with ReadExactly and ReadSome.
+
+#if defined(BOOST_ASIO_HAS_CO_AWAIT)
+
+class EchoConnection : public Connection
+{
+public:
+    EchoConnection(std::shared_ptr<Hive> hive) :
+        Connection(hive)
+    {
+    }
+
+    ~EchoConnection() override = default;
+
+private:
+    void OnAccept(const std::string &host, uint16_t port) override
+    {
+        Recv();
+    }
+
+    void OnConnect(const std::string &host, uint16_t port) override
+    {
+    }
+
+    void OnSend(const std::vector<uint8_t> &buffer) override
+    {
+    }
+
+    void OnRecv(std::vector<uint8_t> &buffer) override
+    {
+        Recv();
+        Send(std::move(buffer));
+    }
+
+    void OnTimer(const boost::posix_time::time_duration &delta) override
+    {
+    }
+
+    void OnError(const boost::system::error_code &error) override
+    {
+    }
+};
+
+// The callbacks stay empty, the coroutine reads and writes the socket
+class ClientConnection : public Connection
+{
+public:
+    ClientConnection(std::shared_ptr<Hive> hive) :
+        Connection(hive)
+    {
+    }
+
+    ~ClientConnection() override = default;
+
+private:
+    void OnAccept(const std::string &host, uint16_t port) override
+    {
+    }
+
+    void OnConnect(const std::string &host, uint16_t port) override
+    {
+    }
+
+    void OnSend(const std::vector<uint8_t> &buffer) override
+    {
+    }
+
+    void OnRecv(std::vector<uint8_t> &buffer) override
+    {
+    }
+
+    void OnTimer(const boost::posix_time::time_duration &delta) override
+    {
+    }
+
+    void OnError(const boost::system::error_code &error) override
+    {
+        Log(BOOST_CURRENT_FUNCTION, ' ', error);
+    }
+};
+
+class EchoAcceptor : public Acceptor
+{
+public:
+    EchoAcceptor(std::shared_ptr<Hive> hive) :
+        Acceptor(hive)
+    {}
+
+    ~EchoAcceptor() override = default;
+
+private:
+    std::shared_ptr<Connection> CreateConnection() override
+    {
+        return std::make_shared<EchoConnection>(GetHive());
+    }
+
+    bool OnAccept(
+        std::shared_ptr<Connection> connection,
+        const std::string &host,
+        uint16_t port
+    ) override
+    {
+        return true;
+    }
+
+    void OnTimer(const boost::posix_time::time_duration &delta) override
+    {
+    }
+
+    void OnError(const boost::system::error_code &error) override
+    {
+    }
+};
+
+boost::asio::awaitable<void> Client(std::shared_ptr<ClientConnection> client, uint16_t port)
+{
+    co_await client->AsyncConnect("localhost", port);
+    Log(BOOST_CURRENT_FUNCTION, " connected to ", client->GetSocket().remote_endpoint());
+
+    std::string message = "Hello, coroutine!";
+    size_t written = co_await client->Write(boost::asio::buffer(message));
+    Log(BOOST_CURRENT_FUNCTION, ' ', written, " bytes written");
+
+    // The first bytes of the echo with exactly known size, the rest with
+    // whatever has arrived
+    auto head = co_await client->ReadExactly(6);
+    Log(BOOST_CURRENT_FUNCTION, " read \"", std::string(head.begin(), head.end()), '"');
+    client->GetHive()->GetBufferPool().Release(std::move(head));
+
+    std::string tail(message.size() - 6, '\0');
+    size_t received = 0;
+    while (received != tail.size())
+    {
+        received += co_await client->ReadSome(
+            boost::asio::buffer(tail.data() + received, tail.size() - received)
+        );
+    }
+    Log(BOOST_CURRENT_FUNCTION, " read \"", tail, '"');
+
+    client->Disconnect();
+}
+
+int main()
+{
+    auto hive = std::make_shared<Hive>();
+    auto acceptor = std::make_shared<EchoAcceptor>(hive);
+    acceptor->Listen("127.0.0.1", 0);
+    acceptor->Accept();
+    std::thread runner([hive]() { hive->Run(); });
+
+    std::promise<void> done;
+    auto client = std::make_shared<ClientConnection>(hive);
+    boost::asio::co_spawn(
+        client->GetStrand(),
+        Client(client, acceptor->GetAcceptor().local_endpoint().port()),
+        [&done](std::exception_ptr exception)
+        {
+            try
+            {
+                if (exception)
+                    std::rethrow_exception(exception);
+            }
+            catch (std::exception &e)
+            {
+                Log(BOOST_CURRENT_FUNCTION, " Exception message: ", e.what(), '.');
+            }
+            done.set_value();
+        }
+    );
+    done.get_future().wait();
+
+    acceptor->Stop();
+    hive->Stop();
+    runner.join();
+
+    return 0;
+}
+
+#else
+
+int main()
+{
+    std::cout << "coroecho needs a compiler with coroutine support, such as -std=c++20\n";
+    return 0;
+}
+
+#endif
@@ -0,0 +1,306 @@
+/* delimbench.cpp */
+#include "wrapper.h"
+#include <boost/current_function.hpp>
+#include <iostream>
+#include <chrono>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <string>
+#include <string_view>
+#include <future>
+#include <random>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+
+// Compares DelimitedConnection with async_read_until on a streambuf, the
+// usual asio way of reading a line protocol.
+//
+// The same stream of messages is written over loopback by a blocking
+// client thread and read once by each reader, which sums the message
+// lengths so that the data is touched. The in-memory rows time the
+// delimiter search alone: DelimitedConnection::Find against
+// std::string_view::find.
+//
+// usage: delimbench [messages] [average message bytes] [lf|crlf|crlfcrlf]
+
+using Clock = std::chrono::steady_clock;
+
+constexpr size_t write_chunk = 64 * 1024;
+constexpr int32_t read_chunk = 64 * 1024;
+
+std::string MakePayload(size_t messages, size_t message_size, const std::string &delimiter)
+{
+    std::mt19937 random(42);
+    std::uniform_int_distribution<size_t> sizes(message_size / 2, message_size + message_size / 2);
+    std::uniform_int_distribution<int> letters('a', 'z');
+    std::string payload;
+    payload.reserve(messages * (message_size + delimiter.size()));
+    for (size_t i = 0; i != messages; ++i)
+    {
+        size_t size = sizes(random);
+        for (size_t n = 0; n != size; ++n)
+            payload.push_back(static_cast<char>(letters(random)));
+        payload += delimiter;
+    }
+    return payload;
+}
+
+// Connects to port and writes the payload in large chunks.
+void WritePayload(uint16_t port, const std::string &payload)
+{
+    boost::asio::io_context io_ctx;
+    boost::asio::ip::tcp::socket socket(io_ctx);
+    socket.connect(
+        boost::asio::ip::tcp::endpoint(boost::asio::ip::address_v4::loopback(), port)
+    );
+    for (size_t offset = 0; offset < payload.size(); offset += write_chunk)
+    {
+        size_t size = std::min(write_chunk, payload.size() - offset);
+        boost::asio::write(socket, boost::asio::buffer(payload.data() + offset, size));
+    }
+    boost::system::error_code ec;
+    socket.shutdown(boost::asio::ip::tcp::socket::shutdown_send, ec);
+}
+
+struct Result
+{
+    double m_seconds;
+    size_t m_messages;
+    uint64_t m_bytes;
+};
+
+Result BenchReadUntil(const std::string &payload, const std::string &delimiter, size_t messages)
+{
+    boost::asio::io_context io_ctx(1);
+    boost::asio::ip::tcp::acceptor acceptor(
+        io_ctx,
+        boost::asio::ip::tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0)
+    );
+    auto start = Clock::now();
+    std::thread writer(&WritePayload, acceptor.local_endpoint().port(), std::cref(payload));
+    boost::asio::ip::tcp::socket socket(io_ctx);
+    acceptor.accept(socket);
+
+    boost::asio::streambuf streambuf;
+    Result result{0.0, 0, 0};
+    std::function<void(const boost::system::error_code &, size_t)> handler;
+    handler = [&](const boost::system::error_code &ec, size_t bytes)
+    {
+        if (ec)
+            return;
+        result.m_bytes += bytes - delimiter.size();
+        streambuf.consume(bytes);
+        if (++result.m_messages != messages)
+            boost::asio::async_read_until(socket, streambuf, delimiter, handler);
+    };
+    boost::asio::async_read_until(socket, streambuf, delimiter, handler);
+    io_ctx.run();
+    result.m_seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    writer.join();
+    return result;
+}
+
+class CountConnection : public DelimitedConnection
+{
+public:
+    CountConnection(std::shared_ptr<Hive> hive) :
+        DelimitedConnection(hive)
+    {
+        SetReceiveBufferSize(read_chunk);
+    }
+
+    ~CountConnection() override = default;
+
+    void SetTarget(size_t messages, std::promise<Result> *done)
+    {
+        m_target = messages;
+        m_done = done;
+    }
+
+private:
+    void OnAccept(const std::string &host, uint16_t port) override
+    {
+        Recv();
+    }
+
+    void OnConnect(const std::string &host, uint16_t port) override
+    {
+    }
+
+    void OnSend(const std::vector<uint8_t> &buffer) override
+    {
+    }
+
+    void OnMessage(boost::asio::const_buffer message) override
+    {
+        m_result.m_bytes += message.size();
+        if (++m_result.m_messages == m_target)
+            m_done->set_value(m_result);
+    }
+
+    void OnTimer(const boost::posix_time::time_duration &delta) override
+    {
+    }
+
+    void OnError(const boost::system::error_code &error) override
+    {
+    }
+
+private:
+    size_t m_target{0};
+    std::promise<Result> *m_done{nullptr};
+    Result m_result{0.0, 0, 0};
+};
+
+class CountAcceptor : public Acceptor
+{
+public:
+    CountAcceptor(
+        std::shared_ptr<Hive> hive,
+        const std::string &delimiter,
+        size_t messages,
+        std::promise<Result> *done
+    ) :
+        Acceptor(hive),
+        m_delimiter(delimiter),
+        m_messages(messages),
+        m_done(done)
+    {}
+
+    ~CountAcceptor() override = default;
+
+private:
+    std::shared_ptr<Connection> CreateConnection() override
+    {
+        auto connection = std::make_shared<CountConnection>(GetHive());
+        connection->SetDelimiter(m_delimiter);
+        connection->SetMaxMessageSize(1024 * 1024);
+        connection->SetTarget(m_messages, m_done);
+        return connection;
+    }
+
+    bool OnAccept(
+        std::shared_ptr<Connection> connection,
+        const std::string &host,
+        uint16_t port
+    ) override
+    {
+        return true;
+    }
+
+    void OnTimer(const boost::posix_time::time_duration &delta) override
+    {
+    }
+
+    void OnError(const boost::system::error_code &error) override
+    {
+    }
+
+private:
+    std::string m_delimiter;
+    size_t m_messages;
+    std::promise<Result> *m_done;
+};
+
+Result BenchDelimitedConnection(const std::string &payload, const std::string &delimiter, size_t messages)
+{
+    std::promise<Result> done;
+    auto future = done.get_future();
+    auto hive = std::make_shared<Hive>();
+    auto acceptor = std::make_shared<CountAcceptor>(hive, delimiter, messages, &done);
+    acceptor->Listen("127.0.0.1", 0);
+    acceptor->Accept();
+    std::thread runner([hive]() { hive->Run(); });
+
+    auto start = Clock::now();
+    std::thread writer(&WritePayload, acceptor->GetAcceptor().local_endpoint().port(), std::cref(payload));
+    Result result = future.get();
+    result.m_seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    writer.join();
+    acceptor->Stop();
+    hive->Stop();
+    runner.join();
+    return result;
+}
+
+// Splits the payload in memory with find, which returns the position of
+// the next delimiter or npos.
+template<class Find>
+Result BenchScan(const std::string &payload, const std::string &delimiter, Find find)
+{
+    Result result{0.0, 0, 0};
+    auto start = Clock::now();
+    size_t position = 0;
+    while (true)
+    {
+        size_t found = find(position);
+        if (std::string_view::npos == found)
+            break;
+        result.m_bytes += found - position;
+        ++result.m_messages;
+        position = found + delimiter.size();
+    }
+    result.m_seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    return result;
+}
+
+int main(int argc, char *argv[])
+{
+    size_t messages = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 2000000;
+    size_t message_size = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 64;
+    std::string delimiter = "\n";
+    if (argc > 3 && 0 == std::strcmp(argv[3], "crlf"))
+        delimiter = "\r\n";
+    else if (argc > 3 && 0 == std::strcmp(argv[3], "crlfcrlf"))
+        delimiter = "\r\n\r\n";
+
+    std::string payload = MakePayload(messages, message_size, delimiter);
+
+    std::cout << BOOST_CURRENT_FUNCTION << ' ' << messages << " messages, "
+              << payload.size() << " bytes, " << delimiter.size()
+              << " byte delimiter\n\n";
+
+    auto report = [messages](const char *name, const Result &result)
+    {
+        char line[160];
+        std::snprintf(
+            line, sizeof(line), "%-34s %10.3f s %12.0f msgs/s %10.1f MB/s%s\n",
+            name, result.m_seconds, result.m_messages / result.m_seconds,
+            result.m_bytes / result.m_seconds / 1e6,
+            result.m_messages == messages ? "" : " (incomplete)"
+        );
+        std::cout << line << std::flush;
+    };
+
+    report("loopback async_read_until", BenchReadUntil(payload, delimiter, messages));
+    report("loopback DelimitedConnection", BenchDelimitedConnection(payload, delimiter, messages));
+
+    std::string_view view(payload);
+    report(
+        "in-memory string_view::find",
+        BenchScan(
+            payload, delimiter,
+            [&view,&delimiter](size_t position) { return view.find(delimiter, position); }
+        )
+    );
+    report(
+        "in-memory DelimitedConnection::Find",
+        BenchScan(
+            payload, delimiter,
+            [&payload,&delimiter](size_t position)
+            {
+                auto data = reinterpret_cast<const uint8_t *>(payload.data());
+                size_t found = position + DelimitedConnection::Find(
+                    data + position, payload.size() - position, delimiter
+                );
+                return found == payload.size() ? std::string_view::npos : found;
+            }
+        )
+    );
+
+    return 0;
+}
@@ -0,0 +1,253 @@
+/* dispatchbench.cpp */
+#include <utility> // ahead of boost/asio.hpp, as in wrapper.h
+#include <boost/asio.hpp>
+#include <boost/current_function.hpp>
+#include <thread>
+#include <iostream>
+#include <chrono>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <cstdlib>
+#include <cstdio>
+#include <algorithm>
+
+// Measures the cost of handing an empty handler to the io_context in the
+// ways the post, dispatch, strand, strandwrap, mutexbind and poll samples
+// show, with 1 to N threads running the io_context.
+//
+// Every benchmark runs a number of independent handler chains, four per
+// thread: each handler submits the next handler of its chain until the
+// chain has run its share of the operations. The reported ns/op is wall
+// time divided by the number of handlers, so a value that drops with more
+// threads means the pattern scales.
+//
+// usage: dispatchbench [operations] [max threads]
+
+using Clock = std::chrono::steady_clock;
+
+constexpr size_t chains_per_thread = 4;
+
+// Padded so that chains run by different threads do not share a cache line
+struct alignas(64) Chain
+{
+    size_t m_remaining;
+};
+
+// Runs io_ctx on threads_count threads, either with run or by calling poll
+// in a loop, and returns the elapsed wall time.
+std::chrono::duration<double> RunThreads(
+    boost::asio::io_context &io_ctx,
+    size_t threads_count,
+    bool use_poll
+)
+{
+    auto start = Clock::now();
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i != threads_count; ++i)
+    {
+        threads.emplace_back(
+            [&io_ctx,use_poll]()
+            {
+                if (use_poll)
+                {
+                    while (!io_ctx.stopped())
+                        io_ctx.poll();
+                }
+                else
+                {
+                    io_ctx.run();
+                }
+            }
+        );
+    }
+    for (auto &&th : threads)
+        th.join();
+    return Clock::now() - start;
+}
+
+// Runs chained handlers that are resubmitted by submit(io_ctx, handler),
+// where submit is returned by make_submit(io_ctx). When guard is not null
+// every handler locks it, as in mutexbind.cpp.
+template<class MakeSubmit>
+double BenchChains(
+    size_t operations,
+    size_t threads_count,
+    MakeSubmit make_submit,
+    std::mutex *guard = nullptr,
+    bool use_poll = false
+)
+{
+    boost::asio::io_context io_ctx(static_cast<int>(threads_count));
+    auto submit = make_submit(io_ctx);
+    using Submit = decltype(submit);
+    size_t chains_count = threads_count * chains_per_thread;
+    size_t chain_length = std::max<size_t>(1, operations / chains_count);
+    std::vector<Chain> chains(chains_count, Chain{chain_length});
+    std::atomic<size_t> running_chains{chains_count};
+    uint64_t guarded_counter = 0;
+
+    struct Handler
+    {
+        boost::asio::io_context *m_io_ctx;
+        Submit *m_submit;
+        Chain *m_chain;
+        std::atomic<size_t> *m_running_chains;
+        std::mutex *m_guard;
+        uint64_t *m_guarded_counter;
+
+        void operator()()
+        {
+            if (m_guard)
+            {
+                std::lock_guard lck(*m_guard);
+                ++*m_guarded_counter;
+            }
+
+            if (--m_chain->m_remaining)
+                (*m_submit)(*m_io_ctx, *this);
+            else if (1 == m_running_chains->fetch_sub(1))
+                m_io_ctx->stop();
+        }
+    };
+
+    for (auto &&chain : chains)
+        submit(io_ctx, Handler{&io_ctx, &submit, &chain, &running_chains, guard, &guarded_counter});
+
+    auto elapsed = RunThreads(io_ctx, threads_count, use_poll);
+    return std::chrono::duration<double, std::nano>(elapsed).count() / (chains_count * chain_length);
+}
+
+// dispatch from a running handler invokes the handler inline, so chaining
+// would recurse. Each posted task instead dispatches a batch of handlers.
+double BenchDispatch(size_t operations, size_t threads_count)
+{
+    constexpr size_t batch = 1000;
+
+    boost::asio::io_context io_ctx(static_cast<int>(threads_count));
+    size_t tasks_count = operations / batch;
+    std::atomic<uint64_t> total{0};
+    for (size_t i = 0; i != tasks_count; ++i)
+    {
+        boost::asio::post(
+            io_ctx,
+            [&io_ctx,&total]()
+            {
+                uint64_t count = 0;
+                for (size_t n = 0; n != batch; ++n)
+                    boost::asio::dispatch(io_ctx, [&count]() { ++count; });
+                total.fetch_add(count, std::memory_order_relaxed);
+            }
+        );
+    }
+
+    auto elapsed = RunThreads(io_ctx, threads_count, false);
+    return std::chrono::duration<double, std::nano>(elapsed).count() / total.load();
+}
+
+int main(int argc, char *argv[])
+{
+    size_t operations = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 2000000;
+    size_t max_threads = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : std::thread::hardware_concurrency();
+    if (0 == max_threads)
+        max_threads = 1;
+
+    std::vector<size_t> thread_counts;
+    for (size_t n = 1; n < max_threads; n *= 2)
+        thread_counts.push_back(n);
+    thread_counts.push_back(max_threads);
+
+    std::cout << BOOST_CURRENT_FUNCTION << ' ' << operations
+              << " handlers per run, ns/op by thread count\n\n";
+
+    char line[128];
+    std::snprintf(line, sizeof(line), "%-26s", "threads");
+    std::cout << line;
+    for (auto &&n : thread_counts)
+    {
+        std::snprintf(line, sizeof(line), "%10zu", n);
+        std::cout << line;
+    }
+    std::cout << '\n';
+
+    auto report = [&thread_counts](const char *name, auto &&bench)
+    {
+        char line[128];
+        std::snprintf(line, sizeof(line), "%-26s", name);
+        std::cout << line << std::flush;
+        for (auto &&n : thread_counts)
+        {
+            std::snprintf(line, sizeof(line), "%10.1f", bench(n));
+            std::cout << line << std::flush;
+        }
+        std::cout << '\n';
+    };
+
+    auto make_post = [](boost::asio::io_context &)
+    {
+        return [](boost::asio::io_context &io, auto &&handler) { boost::asio::post(io, handler); };
+    };
+
+    report(
+        "io_context post",
+        [&](size_t n) { return BenchChains(operations, n, make_post); }
+    );
+
+    report(
+        "io_context dispatch",
+        [&](size_t n) { return BenchDispatch(operations, n); }
+    );
+
+    // One strand shared by every chain, so the handlers are serialized
+    report(
+        "strand post",
+        [&](size_t n)
+        {
+            return BenchChains(
+                operations, n,
+                [](boost::asio::io_context &io)
+                {
+                    return [strand=boost::asio::make_strand(io)](boost::asio::io_context &, auto &&handler)
+                    {
+                        boost::asio::post(strand, handler);
+                    };
+                }
+            );
+        }
+    );
+
+    report(
+        "io_context::strand wrap",
+        [&](size_t n)
+        {
+            return BenchChains(
+                operations, n,
+                [](boost::asio::io_context &io)
+                {
+                    return [strand=std::make_shared<boost::asio::io_context::strand>(io)](boost::asio::io_context &io, auto &&handler)
+                    {
+                        boost::asio::post(io, strand->wrap(handler));
+                    };
+                }
+            );
+        }
+    );
+
+    report(
+        "mutex guarded post",
+        [&](size_t n)
+        {
+            std::mutex guard;
+            return BenchChains(operations, n, make_post, &guard);
+        }
+    );
+
+    report(
+        "io_context poll",
+        [&](size_t n) { return BenchChains(operations, n, make_post, nullptr, true); }
+    );
+
+    return 0;
+}
@@ -1,19 +1,15 @@
 /* echoserver.cpp */
 #include "wrapper.h"
+#include "logger.h"
 #include <boost/current_function.hpp>
 #include <iostream>
-#include <mutex>
 #include <thread>
-#include <algorithm>
-#include <type_traits>
-
-std::mutex global_stream_lock;
 
 class MyConnection : public Connection
 {
 public:
     MyConnection(std::shared_ptr<Hive> hive) :
-        Connection(hive) 
+        Connection(hive)
     {
     }
 
@@ -22,72 +18,32 @@ public:
 private:
     void OnAccept(const std::string &host, uint16_t port) override
     {
-        {
-            std::lock_guard lck(global_stream_lock);
-            std::cout << "Thread#" << std::this_thread::get_id() << ' '
-                      << BOOST_CURRENT_FUNCTION
-                      << ' ' << host << ':' << port << '\n';
-        }
+        Log(BOOST_CURRENT_FUNCTION, ' ', host, ':', port);
 
         Recv();
     }
 
     void OnConnect(const std::string &host, uint16_t port) override
     {
-        {
-            std::lock_guard lck(global_stream_lock);
-            std::cout << "Thread#" << std::this_thread::get_id() << ' '
-                      << BOOST_CURRENT_FUNCTION
-                      << ' ' << host << ':' << port << '\n';
-        }
+        Log(BOOST_CURRENT_FUNCTION, ' ', host, ':', port);
 
         Recv();
     }
 
     void OnSend(const std::vector<uint8_t> &buffer) override
     {
-        std::lock_guard lck(global_stream_lock);
-        std::cout << "Thread#" << std::this_thread::get_id() << ' '
-                  << BOOST_CURRENT_FUNCTION
-                  << ' ' << buffer.size() << " bytes to "
-                  << GetSocket().remote_endpoint() << ": ";
-
-        for (size_t x = 0; x < buffer.size(); ++x)
-        {
-            if (isprint(buffer[x]) && !iscntrl(buffer[x]))
-                std::cout  << buffer[x] << ' ';
-            else
-                std::cout << std::hex << "0x" << (int)buffer[x] << ' ';
-
-            if (x && (x) % 16 == 0)
-                std::cout << '\n';
-        }
-
-        std::cout << std::endl;
+        Log(
+            BOOST_CURRENT_FUNCTION, ' ', buffer.size(), " bytes to ",
+            GetSocket().remote_endpoint(), ": ", LogHex(buffer)
+        );
     }
 
     void OnRecv(std::vector<uint8_t> &buffer) override
     {
-        {
-            std::lock_guard lck(global_stream_lock);
-            std::cout << "Thread#" << std::this_thread::get_id() << ' '
-                      << BOOST_CURRENT_FUNCTION
-                      << ' ' << buffer.size() << " bytes from "
-                      << GetSocket().remote_endpoint() << ": ";
-
-            for (size_t x = 0; x < buffer.size(); ++x)
-            {
-                if (isprint(buffer[x]) && !iscntrl(buffer[x]))
-                    std::cout  << buffer[x] << ' ';
-                else
-                    std::cout << std::hex << "0x" << (int)buffer[x] << ' ';
-
-                if (x && (x) % 16 == 0)
-                    std::cout << '\n';
-            }
-
-            std::cout << std::endl;
-        }
+        Log(
+            BOOST_CURRENT_FUNCTION, ' ', buffer.size(), " bytes from ",
+            GetSocket().remote_endpoint(), ": ", LogHex(buffer)
+        );
 
         // Start the next receive
         Recv();
@@ -98,158 +54,108 @@ private:
 
     void OnTimer(const boost::posix_time::time_duration &delta) override
     {
-        std::lock_guard lck(global_stream_lock);
-        std::cout << "Thread#" << std::this_thread::get_id() << ' '
-                  << BOOST_CURRENT_FUNCTION << ' '
-		  << GetSocket().remote_endpoint()
-                  << ' ' << delta << '\n';
+        Log(BOOST_CURRENT_FUNCTION, ' ', GetSocket().remote_endpoint(), ' ', delta);
     }
 
     void OnError(const boost::system::error_code &error) override
     {
-        std::lock_guard lck(global_stream_lock);
-	std::cout << std::flush;
-        std::cout << "Thread#" << std::this_thread::get_id() << ' '
-                  << BOOST_CURRENT_FUNCTION 
-                  << ' ' << error << '\n' << std::flush;
+        Log(BOOST_CURRENT_FUNCTION, ' ', error);
     }
 };
 
 class MyAcceptor : public Acceptor
 {
 public:
-    MyAcceptor(std::shared_ptr<Hive> hive) : 
-        Acceptor(hive)
+    MyAcceptor(std::shared_ptr<Hive> hive) :
+        Acceptor(hive),
+        m_pool(std::make_shared<ConnectionPool<MyConnection> >(hive))
     {}
 
     ~MyAcceptor() override = default;
 
-    void Accept()
+private:
+    std::shared_ptr<Connection> CreateConnection() override
     {
-        auto connection = std::make_shared<MyConnection>(GetHive());
-        Acceptor::Accept(connection);
+        // Disconnected clients are recycled instead of destroyed
+        return m_pool->Acquire();
     }
 
-private:
     bool OnAccept(
         std::shared_ptr<Connection> connection,
         const std::string &host,
         uint16_t port
     ) override
     {
-        {
-            std::lock_guard lck(global_stream_lock);
-            std::cout << "Thread#" << std::this_thread::get_id() << ' '
-                      << BOOST_CURRENT_FUNCTION
-                          << ' ' << host << ':' << port << '\n';
-        }
-        auto new_conn = std::make_shared<MyConnection>(GetHive());
-        Acceptor::Accept(new_conn);
+        Log(BOOST_CURRENT_FUNCTION, ' ', host, ':', port);
         return true;
     }
 
     void OnTimer(const boost::posix_time::time_duration &delta) override
     {
-        std::lock_guard lck(global_stream_lock);
-        std::cout << "Thread#" << std::this_thread::get_id() << ' '
-                  << BOOST_CURRENT_FUNCTION
-                  << ' ' << delta << '\n';
+        Log(BOOST_CURRENT_FUNCTION, ' ', delta);
     }
 
     void OnError(const boost::system::error_code &error) override
     {
-        std::lock_guard lck(global_stream_lock);
-        std::cout << "Thread#" << std::this_thread::get_id() << ' '
-                  << BOOST_CURRENT_FUNCTION
-                  << ' ' << error << '\n';
+        Log(BOOST_CURRENT_FUNCTION, ' ', error);
     }
+
+private:
+    std::shared_ptr<ConnectionPool<MyConnection> > m_pool;
 };
 
 
-void WorkerThread(boost::asio::io_context &ioctx, size_t counter)
+void WorkerThread(std::shared_ptr<Hive> hive, size_t counter)
 {
-    {
-        std::lock_guard lck(global_stream_lock);
-        std::cout << "Thread#" << std::this_thread::get_id() << ' '
-                  << BOOST_CURRENT_FUNCTION << ' '
-                  << counter << " Start.\n";
-    }
+    Log(BOOST_CURRENT_FUNCTION, ' ', counter, " Start.");
 
     while (true)
     {
         try
         {
-            boost::system::error_code ec;
-            ioctx.run(ec);
-            if (ec)
-            {
-                std::lock_guard lck(global_stream_lock);
-                std::cout << "Thread#" << std::this_thread::get_id() << ' '
-                          << BOOST_CURRENT_FUNCTION
-                          << " Error message: " << ec << ".\n";
-            }
+            // Hive::Run also refreshes the Hive's cached clock
+            hive->Run();
             break;
         }
         catch (std::exception &e)
         {
-            std::lock_guard lck(global_stream_lock);
-            std::cout << "Thread#" << std::this_thread::get_id() << ' '
-                      << BOOST_CURRENT_FUNCTION
-                      << " Exception message: " << e.what() << ".\n";
+            Log(BOOST_CURRENT_FUNCTION, " Exception message: ", e.what(), '.');
         }
     }
 
-    std::lock_guard lck(global_stream_lock);
-    std::cout << "Thread#" << std::this_thread::get_id() << ' '
-              << BOOST_CURRENT_FUNCTION << ' '
-              << counter << " End.\n";
+    Log(BOOST_CURRENT_FUNCTION, ' ', counter, " End.");
 }
 
 int main()
 {
-    std::cout << "Thread#" << std::this_thread::get_id() << ' '
-              << BOOST_CURRENT_FUNCTION
-              << " Press ENTER to exit!\n";
+    Log(BOOST_CURRENT_FUNCTION, " Press ENTER to exit!");
 
-    auto hive = std::make_shared<Hive>();
+    // One Hive per hardware thread, each run by exactly one thread
+    HivePool pool;
 
-    auto acceptor = std::make_shared<MyAcceptor>(hive);
-    acceptor->Listen("127.0.0.1", 4444);
-
-    acceptor->Accept();
-
-    auto threads_count = std::thread::hardware_concurrency();
-    std::vector<std::thread> threads(threads_count);
+    // One SO_REUSEPORT listener per Hive, so the kernel spreads the new
+    // connections over the threads without a shared accept queue
+    std::vector<std::shared_ptr<MyAcceptor> > acceptors;
+    for (size_t i = 0; i != pool.GetSize(); ++i)
     {
-        size_t i = 0;
-        std::transform(
-            threads.cbegin(),
-            threads.cend(),
-            threads.begin(),
-            [&n=i,&io=hive->GetContext()](auto &&th)
-            {
-                ++n;
-                return std::decay_t<decltype(th)>(&WorkerThread, std::ref(io), n);
-            }
-        );
+        auto acceptor = std::make_shared<MyAcceptor>(pool.GetHive(i));
+        acceptor->SetReusePort(true);
+        acceptor->SetPendingAccepts(16);
+        acceptor->Listen("127.0.0.1", 4444);
+        acceptor->Accept();
+        acceptors.emplace_back(std::move(acceptor));
     }
-    
+
+    pool.Run(&WorkerThread);
+
     std::cin.get();
 
-    boost::system::error_code ec;
-    acceptor->GetAcceptor().close(ec);
+    for (auto &&acceptor : acceptors)
+        acceptor->Stop();
 
-    hive->Stop();
+    pool.Stop();
 
-    for (auto &&th : threads)
-    {
-        if (th.joinable())
-            th.join();
-    }
-    
-    std::cout << "Thread#" << std::this_thread::get_id() << ' '
-              << BOOST_CURRENT_FUNCTION
-              << " Exit caused by press ENTER!\n";
+    Log(BOOST_CURRENT_FUNCTION, " Exit caused by press ENTER!");
 
     return 0;
 }
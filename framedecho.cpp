@@ -0,0 +1,184 @@
+/* framedecho.cpp */
+#include "wrapper.h"
+#include "logger.h"
+#include <boost/current_function.hpp>
+#include <iostream>
+#include <thread>
+#include <future>
+#include <string>
+
+// Echoes length prefixed frames over loopback with FramedConnection. The
+// client uses a one byte prefix and a 100 byte maximum, sends a frame that
+// fits and then tries a frame over the maximum and, with the maximum
+// raised, one over the 255 bytes the prefix can hold. SendFrame refuses
+// both with message_size before anything is queued, and the connection
+// stays usable.
+
+constexpr size_t max_frame_size = 100;
+
+class EchoConnection : public FramedConnection
+{
+public:
+    EchoConnection(std::shared_ptr<Hive> hive) :
+        FramedConnection(hive)
+    {
+        SetHeaderType(HeaderType::uint8);
+        SetMaxFrameSize(max_frame_size);
+    }
+
+    ~EchoConnection() override = default;
+
+private:
+    void OnAccept(const std::string &host, uint16_t port) override
+    {
+        Log(BOOST_CURRENT_FUNCTION, ' ', host, ':', port);
+
+        Recv();
+    }
+
+    void OnConnect(const std::string &host, uint16_t port) override
+    {
+    }
+
+    void OnSend(const std::vector<uint8_t> &buffer) override
+    {
+    }
+
+    void OnFrame(boost::asio::const_buffer frame) override
+    {
+        Log(BOOST_CURRENT_FUNCTION, ' ', frame.size(), " bytes");
+
+        SendFrame(frame);
+    }
+
+    void OnTimer(const boost::posix_time::time_duration &delta) override
+    {
+    }
+
+    void OnError(const boost::system::error_code &error) override
+    {
+        Log(BOOST_CURRENT_FUNCTION, ' ', error);
+    }
+};
+
+class ClientConnection : public FramedConnection
+{
+public:
+    ClientConnection(std::shared_ptr<Hive> hive, std::promise<void> *done) :
+        FramedConnection(hive),
+        m_done(done)
+    {
+        SetHeaderType(HeaderType::uint8);
+        SetMaxFrameSize(max_frame_size);
+    }
+
+    ~ClientConnection() override = default;
+
+private:
+    void OnAccept(const std::string &host, uint16_t port) override
+    {
+    }
+
+    void OnConnect(const std::string &host, uint16_t port) override
+    {
+        Log(BOOST_CURRENT_FUNCTION, ' ', host, ':', port);
+
+        Recv();
+        TrySendFrame(std::string(max_frame_size, 'a'));
+        TrySendFrame(std::string(max_frame_size + 1, 'b'));
+
+        // Within the new maximum but over what a one byte prefix can hold
+        SetMaxFrameSize(1024);
+        TrySendFrame(std::string(300, 'c'));
+    }
+
+    void OnSend(const std::vector<uint8_t> &buffer) override
+    {
+    }
+
+    void OnFrame(boost::asio::const_buffer frame) override
+    {
+        Log(BOOST_CURRENT_FUNCTION, " echo of ", frame.size(), " bytes");
+
+        m_done->set_value();
+    }
+
+    void OnTimer(const boost::posix_time::time_duration &delta) override
+    {
+    }
+
+    void OnError(const boost::system::error_code &error) override
+    {
+        Log(BOOST_CURRENT_FUNCTION, ' ', error);
+    }
+
+    void TrySendFrame(const std::string &payload)
+    {
+        try
+        {
+            SendFrame(boost::asio::buffer(payload));
+            Log(BOOST_CURRENT_FUNCTION, ' ', payload.size(), " bytes sent");
+        }
+        catch (boost::system::system_error &e)
+        {
+            Log(BOOST_CURRENT_FUNCTION, ' ', payload.size(), " bytes refused: ", e.code());
+        }
+    }
+
+private:
+    std::promise<void> *m_done;
+};
+
+class EchoAcceptor : public Acceptor
+{
+public:
+    EchoAcceptor(std::shared_ptr<Hive> hive) :
+        Acceptor(hive)
+    {}
+
+    ~EchoAcceptor() override = default;
+
+private:
+    std::shared_ptr<Connection> CreateConnection() override
+    {
+        return std::make_shared<EchoConnection>(GetHive());
+    }
+
+    bool OnAccept(
+        std::shared_ptr<Connection> connection,
+        const std::string &host,
+        uint16_t port
+    ) override
+    {
+        return true;
+    }
+
+    void OnTimer(const boost::posix_time::time_duration &delta) override
+    {
+    }
+
+    void OnError(const boost::system::error_code &error) override
+    {
+    }
+};
+
+int main()
+{
+    auto hive = std::make_shared<Hive>();
+    auto acceptor = std::make_shared<EchoAcceptor>(hive);
+    acceptor->Listen("127.0.0.1", 0);
+    acceptor->Accept();
+    std::thread runner([hive]() { hive->Run(); });
+
+    std::promise<void> done;
+    auto client = std::make_shared<ClientConnection>(hive, &done);
+    client->Connect("127.0.0.1", acceptor->GetAcceptor().local_endpoint().port());
+    done.get_future().wait();
+
+    client->Disconnect();
+    acceptor->Stop();
+    hive->Stop();
+    runner.join();
+
+    return 0;
+}
@@ -0,0 +1,1548 @@
+/* http.cpp */
+#include "http.h"
+#include "logger.h"
+#include <charconv>
+#include <algorithm>
+#include <cstring>
+#include <chrono>
+#include <ctime>
+
+namespace
+{
+	constexpr std::string_view crlf = "\r\n";
+	constexpr std::string_view crlfcrlf = "\r\n\r\n";
+
+	// Longest chunk size line accepted, extensions included
+	constexpr size_t max_chunk_line = 1024;
+
+	bool IEquals(std::string_view lhs, std::string_view rhs)
+	{
+		return lhs.size() == rhs.size() && std::equal(
+            lhs.begin(),
+            lhs.end(),
+            rhs.begin(),
+            [](char a, char b)
+            {
+                return (a | 0x20) == (b | 0x20);
+            }
+        );
+	}
+
+	// Returns true if the comma separated list value holds token
+	bool HasToken(std::string_view value, std::string_view token)
+	{
+		while (!value.empty())
+		{
+			size_t comma = value.find(',');
+			std::string_view item = value.substr(0, comma);
+			while (!item.empty() && (' ' == item.front() || '\t' == item.front()))
+				item.remove_prefix(1);
+			while (!item.empty() && (' ' == item.back() || '\t' == item.back()))
+				item.remove_suffix(1);
+			if (IEquals(item, token))
+				return true;
+			if (std::string_view::npos == comma)
+				break;
+			value.remove_prefix(comma + 1);
+		}
+		return false;
+	}
+
+	size_t FindIn(const uint8_t *data, size_t size, std::string_view delimiter)
+	{
+		return DelimitedConnection::Find(data, size, delimiter);
+	}
+
+	// Parses the header lines of head, which ends with the empty line, into
+	// headers. Returns false if a line is malformed.
+	bool ParseHeaderLines(std::string_view head, std::vector<HttpHeader> &headers)
+	{
+		headers.clear();
+		while (true)
+		{
+			size_t line_end = head.find(crlf);
+			if (std::string_view::npos == line_end)
+				return false;
+			if (0 == line_end)
+				return true;
+
+			std::string_view line = head.substr(0, line_end);
+			head.remove_prefix(line_end + crlf.size());
+
+			// Folded lines are obsolete and rejected, as RFC 7230 allows
+			size_t colon = line.find(':');
+			if (std::string_view::npos == colon || 0 == colon ||
+                ' ' == line.front() || '\t' == line.front() ||
+                ' ' == line[colon - 1] || '\t' == line[colon - 1])
+				return false;
+
+			std::string_view value = line.substr(colon + 1);
+			while (!value.empty() && (' ' == value.front() || '\t' == value.front()))
+				value.remove_prefix(1);
+			while (!value.empty() && (' ' == value.back() || '\t' == value.back()))
+				value.remove_suffix(1);
+			headers.push_back(HttpHeader{line.substr(0, colon), value});
+		}
+	}
+
+	// Decodes the chunked body that starts at body_begin in place: the chunk
+	// data moves over the chunk size lines that precede it. chunk_position
+	// and body_end carry the progress from one call to the next and start 
+	// at body_begin. Trailer fields are skipped.
+	HttpParseResult DecodeChunks(
+        uint8_t *data,
+        size_t size,
+        size_t body_begin,
+        size_t max_body_size,
+        size_t max_trailer_size,
+        size_t &chunk_position,
+        size_t &body_end,
+        size_t &consumed
+    )
+	{
+		while (true)
+		{
+			size_t line = chunk_position;
+			size_t line_end = line + FindIn(data + line, size - line, crlf);
+			if (line_end == size)
+				return size - line > max_chunk_line ? HttpParseResult::error : HttpParseResult::incomplete;
+
+			// chunk-size [; extensions] CRLF
+			uint64_t chunk_size = 0;
+			auto result = std::from_chars(
+                reinterpret_cast<const char *>(data + line),
+                reinterpret_cast<const char *>(data + line_end),
+                chunk_size,
+                16
+            );
+			if (
+                result.ec != std::errc() ||
+                (result.ptr != reinterpret_cast<const char *>(data + line_end) &&
+                 ';' != *result.ptr && ' ' != *result.ptr && '\t' != *result.ptr)
+            )
+				return HttpParseResult::error;
+
+			size_t payload = line_end + crlf.size();
+			if (0 == chunk_size)
+			{
+				// Trailer fields are skipped up to the empty line
+				if (size - payload < crlf.size())
+					return HttpParseResult::incomplete;
+				if ('\r' == data[payload] && '\n' == data[payload + 1])
+				{
+					consumed = payload + crlf.size();
+					return HttpParseResult::complete;
+				}
+				size_t end = payload + FindIn(data + payload, size - payload, crlfcrlf);
+				if (end == size)
+					return size - payload > max_trailer_size ? HttpParseResult::error : HttpParseResult::incomplete;
+				consumed = end + crlfcrlf.size();
+				return HttpParseResult::complete;
+			}
+
+			if (chunk_size > max_body_size - (body_end - body_begin))
+				return HttpParseResult::body_too_large;
+			if (size - payload < chunk_size + crlf.size())
+				return HttpParseResult::incomplete;
+			if ('\r' != data[payload + chunk_size] || '\n' != data[payload + chunk_size + 1])
+				return HttpParseResult::error;
+
+			std::memmove(data + body_end, data + payload, chunk_size);
+			body_end += chunk_size;
+			chunk_position = payload + chunk_size + crlf.size();
+		}
+	}
+}
+
+// HttpResponse::GetHeader definition
+std::string_view HttpResponse::GetHeader(std::string_view name) const
+{
+	for (auto &&header : m_headers)
+	{
+		if (IEquals(header.m_name, name))
+			return header.m_value;
+	}
+	return std::string_view();
+}
+
+// HttpResponseParser::Parse definition
+HttpResponseParser::Result HttpResponseParser::Parse(
+    uint8_t *data,
+    size_t size,
+    bool head_request,
+    HttpResponse &response,
+    size_t &consumed
+)
+{
+	if (!m_header_size)
+	{
+		size_t found = m_scanned + FindIn(data + m_scanned, size - m_scanned, crlfcrlf);
+		if (found == size)
+		{
+			if (size > m_max_header_size)
+				return Result::error;
+			// The last bytes may start the empty line
+			m_scanned = size - std::min(size, crlfcrlf.size() - 1);
+			return Result::incomplete;
+		}
+		m_header_size = found + crlfcrlf.size();
+		if (m_header_size > m_max_header_size)
+			return Result::error;
+		if (Result::error == ParseHead(data, head_request, response))
+			return Result::error;
+		m_chunk_position = m_body_end = m_header_size;
+	}
+
+	switch (m_body)
+	{
+	case Body::none:
+		consumed = m_header_size;
+		m_body_end = m_header_size;
+		break;
+	case Body::length:
+		if (size - m_header_size < m_content_length)
+			return Result::incomplete;
+		consumed = m_header_size + m_content_length;
+		m_body_end = consumed;
+		break;
+	case Body::chunked:
+	{
+		Result result = DecodeChunks(
+            data,
+            size,
+            m_header_size,
+            m_max_body_size,
+            m_max_header_size,
+            m_chunk_position,
+            m_body_end,
+            consumed
+        );
+		if (Result::body_too_large == result)
+			return Result::error;
+		if (Result::complete != result)
+			return result;
+		break;
+	}
+	case Body::close:
+		return Result::incomplete;
+	}
+
+	// The views are taken again if the buffer moved since the headers
+	if (m_head_data != data && Result::error == ParseHead(data, head_request, response))
+		return Result::error;
+	response.m_body = std::string_view(
+        reinterpret_cast<const char *>(data + m_header_size),
+        m_body_end - m_header_size
+    );
+	return Result::complete;
+}
+
+// HttpResponseParser::ParseCloseDelimited definition
+HttpResponseParser::Result HttpResponseParser::ParseCloseDelimited(
+    const uint8_t *data,
+    size_t size,
+    HttpResponse &response
+)
+{
+	if (Body::close != m_body || size < m_header_size || IsCloseDelimitedTooLarge(size))
+		return Result::error;
+	if (Result::error == ParseHead(data, false, response))
+		return Result::error;
+	response.m_body = std::string_view(
+        reinterpret_cast<const char *>(data + m_header_size),
+        size - m_header_size
+    );
+	return Result::complete;
+}
+
+// HttpResponseParser::Reset definition
+void HttpResponseParser::Reset()
+{
+	m_header_size = 0;
+	m_scanned = 0;
+	m_head_data = nullptr;
+	m_body = Body::none;
+	m_content_length = 0;
+	m_chunk_position = 0;
+	m_body_end = 0;
+}
+
+// HttpResponseParser::IsCloseDelimited definition
+bool HttpResponseParser::IsCloseDelimited() const
+{
+	return m_header_size && Body::close == m_body;
+}
+
+// HttpResponseParser::IsCloseDelimitedTooLarge definition
+bool HttpResponseParser::IsCloseDelimitedTooLarge(size_t size) const
+{
+	return size > m_header_size && size - m_header_size > m_max_body_size;
+}
+
+// HttpResponseParser::SetMaxHeaderSize definition
+void HttpResponseParser::SetMaxHeaderSize(size_t max_header_size)
+{
+	m_max_header_size = max_header_size;
+}
+
+// HttpResponseParser::SetMaxBodySize definition
+void HttpResponseParser::SetMaxBodySize(size_t max_body_size)
+{
+	m_max_body_size = max_body_size;
+}
+
+// HttpResponseParser::ParseHead definition
+HttpResponseParser::Result HttpResponseParser::ParseHead(
+    const uint8_t *data,
+    bool head_request,
+    HttpResponse &response
+)
+{
+	m_head_data = data;
+	std::string_view head(reinterpret_cast<const char *>(data), m_header_size);
+
+	// HTTP/1.x SP status [SP reason] CRLF
+	size_t line_end = head.find(crlf);
+	std::string_view line = head.substr(0, line_end);
+	if (line.size() < 12 || line.substr(0, 7) != "HTTP/1." ||
+        line[7] < '0' || line[7] > '9' || ' ' != line[8])
+		return Result::error;
+	response.m_version_minor = line[7] - '0';
+	auto status_result = std::from_chars(line.data() + 9, line.data() + 12, response.m_status);
+	if (status_result.ec != std::errc() || status_result.ptr != line.data() + 12 ||
+        response.m_status < 100)
+		return Result::error;
+	response.m_reason = line.size() > 13 ? line.substr(13) : std::string_view();
+
+	if (!ParseHeaderLines(head.substr(line_end + crlf.size()), response.m_headers))
+		return Result::error;
+
+	// Transfer-Encoding wins over Content-Length, and a body that is not
+	// chunked then runs to the end of the connection (RFC 7230 3.3.3)
+	bool has_length = false;
+	bool has_encoding = false;
+	bool chunked = false;
+	bool close = false;
+	bool keep_alive = false;
+	for (auto &&header : response.m_headers)
+	{
+		if (IEquals(header.m_name, "Content-Length"))
+		{
+			uint64_t length = 0;
+			auto result = std::from_chars(
+                header.m_value.data(),
+                header.m_value.data() + header.m_value.size(),
+                length
+            );
+			if (result.ec != std::errc() || result.ptr != header.m_value.data() + header.m_value.size() ||
+                (has_length && length != m_content_length))
+				return Result::error;
+			has_length = true;
+			m_content_length = length;
+		}
+		else if (IEquals(header.m_name, "Transfer-Encoding"))
+		{
+			has_encoding = true;
+			std::string_view value = header.m_value;
+			size_t comma = value.rfind(',');
+			if (std::string_view::npos != comma)
+				value.remove_prefix(comma + 1);
+			chunked = HasToken(value, "chunked");
+		}
+		else if (IEquals(header.m_name, "Connection"))
+		{
+			close = close || HasToken(header.m_value, "close");
+			keep_alive = keep_alive || HasToken(header.m_value, "keep-alive");
+		}
+	}
+
+	if (head_request || response.m_status < 200 || 204 == response.m_status || 304 == response.m_status)
+		m_body = Body::none;
+	else if (has_encoding)
+		m_body = chunked ? Body::chunked : Body::close;
+	else if (has_length)
+		m_body = Body::length;
+	else
+		m_body = Body::close;
+
+	if (Body::length == m_body && m_content_length > m_max_body_size)
+		return Result::error;
+
+	response.m_keep_alive = Body::close != m_body && !close &&
+        (response.m_version_minor >= 1 || keep_alive);
+	return Result::complete;
+}
+
+// HttpClientConnection constructor
+HttpClientConnection::HttpClientConnection(
+    std::shared_ptr<Hive> hive,
+    std::weak_ptr<HttpClient> client,
+    const std::string &host,
+    uint16_t port,
+    size_t max_pipeline_depth,
+    int32_t idle_timeout_ms
+) :
+    Connection(hive),
+    m_client(std::move(client)),
+    m_host(host),
+    m_port(port),
+    m_key(host + ':' + std::to_string(port)),
+    m_max_pipeline_depth(std::max<size_t>(1, max_pipeline_depth)),
+    m_idle_timeout_ms(idle_timeout_ms),
+    m_last_activity(hive->GetTime())
+{
+	SetReceiveBufferSize(64 * 1024);
+}
+
+// HttpClientConnection::Enqueue definition
+void HttpClientConnection::Enqueue(Request &&request)
+{
+	m_outstanding.fetch_add(1, std::memory_order_relaxed);
+	boost::asio::post(
+        GetStrand(),
+        MakeAllocHandler(
+            m_handler_memory,
+            [self=std::static_pointer_cast<HttpClientConnection>(shared_from_this()),
+             request=std::move(request)]() mutable
+            {
+                if (self->HasError() || !self->IsReusable())
+                {
+                    // Retired between the choice of the client and now
+                    self->m_outstanding.fetch_sub(1, std::memory_order_relaxed);
+                    if (auto client = self->m_client.lock())
+                        client->Dispatch(self->m_host, self->m_port, std::move(request));
+                    else
+                        request.m_handler(boost::asio::error::operation_aborted, HttpResponse());
+                    return;
+                }
+                self->m_unsent.push_back(std::move(request));
+                self->StartRequests();
+            }
+        )
+    );
+}
+
+// HttpClientConnection::GetOutstandingCount definition
+size_t HttpClientConnection::GetOutstandingCount() const
+{
+	return m_outstanding.load(std::memory_order_relaxed);
+}
+
+// HttpClientConnection::IsReusable definition
+bool HttpClientConnection::IsReusable() const
+{
+	return m_reusable.load(std::memory_order_relaxed);
+}
+
+// HttpClientConnection::StartRequests definition
+void HttpClientConnection::StartRequests()
+{
+	if (!m_connected)
+		return;
+
+	while (!m_unsent.empty() && m_in_flight.size() < m_max_pipeline_depth)
+	{
+		Request &request = m_unsent.front();
+		if (request.m_idempotent)
+		{
+			// Kept in case the request has to be written again
+			auto data = GetHive()->GetBufferPool().Acquire(request.m_data.size());
+			data.assign(request.m_data.begin(), request.m_data.end());
+			DispatchSend(std::move(data));
+		}
+		else
+		{
+			DispatchSend(std::move(request.m_data));
+		}
+		m_in_flight.push_back(std::move(request));
+		m_unsent.pop_front();
+	}
+}
+
+// HttpClientConnection::Fail definition
+void HttpClientConnection::Fail(const boost::system::error_code &error)
+{
+	// A connection that answered requests closed in between, which servers
+	// do with idle connections. Retrying on such a connection always makes
+	// progress, unlike retrying on one that never answered.
+	auto client = m_answered ? m_client.lock() : std::shared_ptr<HttpClient>();
+	bool partial = m_partial;
+	HttpResponse response;
+	size_t retried = 0;
+	size_t failed = 0;
+	while (!m_in_flight.empty())
+	{
+		auto request = std::move(m_in_flight.front());
+		m_in_flight.pop_front();
+		m_outstanding.fetch_sub(1, std::memory_order_relaxed);
+		if (client && request.m_idempotent && !partial)
+		{
+			client->Dispatch(m_host, m_port, std::move(request));
+			++retried;
+		}
+		else
+		{
+			request.m_handler(error, response);
+			++failed;
+		}
+		partial = false;
+	}
+	m_partial = false;
+
+	if (retried)
+		Log("HttpClient: retrying ", retried, " requests to ", m_host, ':', m_port, " after: ", error.message());
+	if (failed)
+		Log("HttpClient: ", failed, " requests to ", m_host, ':', m_port, " failed: ", error.message());
+}
+
+// HttpClientConnection::Retire definition. error is the reason the
+// connection stops taking requests.
+void HttpClientConnection::Retire(const boost::system::error_code &error)
+{
+	m_reusable.store(false, std::memory_order_relaxed);
+	auto client = m_client.lock();
+	if (client)
+		client->Remove(m_key, this);
+
+	// Requests that were not written move to another connection, unless
+	// this one never connected, as the next one would most likely fail the
+	// same way. They then fail with the resolve or connect error.
+	size_t failed = 0;
+	while (!m_unsent.empty())
+	{
+		auto request = std::move(m_unsent.front());
+		m_unsent.pop_front();
+		m_outstanding.fetch_sub(1, std::memory_order_relaxed);
+		if (client && m_connected)
+		{
+			client->Dispatch(m_host, m_port, std::move(request));
+		}
+		else if (m_connected)
+		{
+			request.m_handler(boost::asio::error::operation_aborted, HttpResponse());
+		}
+		else
+		{
+			request.m_handler(error, HttpResponse());
+			++failed;
+		}
+	}
+
+	if (failed)
+		Log("HttpClient: ", failed, " requests to ", m_host, ':', m_port, " failed to connect: ", error.message());
+}
+
+// HttpClientConnection::FailCloseDelimited definition. Fails the close 
+// delimited response being received once its body exceeds the maximum, 
+// instead of buffering it up to the end of the connection.
+void HttpClientConnection::FailCloseDelimited()
+{
+	auto request = std::move(m_in_flight.front());
+	m_in_flight.pop_front();
+	m_outstanding.fetch_sub(1, std::memory_order_relaxed);
+	m_close_buffer.clear();
+	m_close_buffer.shrink_to_fit();
+	m_parser.Reset();
+	request.m_handler(boost::asio::error::message_size, HttpResponse());
+	StartError(boost::asio::error::message_size);
+}
+
+// HttpClientConnection::OnAccept definition
+void HttpClientConnection::OnAccept(const std::string &/*host*/, uint16_t /*port*/)
+{
+}
+
+// HttpClientConnection::OnConnect definition
+void HttpClientConnection::OnConnect(const std::string &/*host*/, uint16_t /*port*/)
+{
+	m_connected = true;
+	m_last_activity = GetHive()->GetTime();
+	DispatchRecv(0);
+	StartRequests();
+}
+
+// HttpClientConnection::OnSend definition
+void HttpClientConnection::OnSend(const std::vector<uint8_t> &/*buffer*/)
+{
+}
+
+// HttpClientConnection::OnRecv definition
+void HttpClientConnection::OnRecv(std::vector<uint8_t> &buffer)
+{
+	m_last_activity = GetHive()->GetTime();
+	size_t offset = GetRecvOffset();
+	if (!m_close_buffer.empty())
+	{
+		// The body of the response runs to the end of the connection
+		m_close_buffer.insert(m_close_buffer.end(), buffer.begin() + offset, buffer.end());
+		if (m_parser.IsCloseDelimitedTooLarge(m_close_buffer.size()))
+		{
+			FailCloseDelimited();
+			return;
+		}
+		DispatchRecv(0);
+		return;
+	}
+
+	uint8_t *data = buffer.data() + offset;
+	size_t size = buffer.size() - offset;
+	size_t position = 0;
+	while (position < size)
+	{
+		if (m_in_flight.empty())
+		{
+			// Bytes that do not answer any request
+			StartError(boost::asio::error::invalid_argument);
+			return;
+		}
+
+		size_t consumed = 0;
+		auto result = m_parser.Parse(
+            data + position,
+            size - position,
+            m_in_flight.front().m_head,
+            m_response,
+            consumed
+        );
+		if (HttpResponseParser::Result::error == result)
+		{
+			StartError(boost::asio::error::invalid_argument);
+			return;
+		}
+		if (HttpResponseParser::Result::incomplete == result)
+		{
+			if (m_parser.IsCloseDelimited())
+			{
+				m_close_buffer.assign(data + position, data + size);
+				Retire(boost::asio::error::eof);
+				if (m_parser.IsCloseDelimitedTooLarge(m_close_buffer.size()))
+				{
+					FailCloseDelimited();
+					return;
+				}
+				DispatchRecv(0);
+				return;
+			}
+			break;
+		}
+
+		position += consumed;
+		m_parser.Reset();
+		m_partial = false;
+		++m_answered;
+
+		// Interim responses such as 100 Continue precede the final one
+		if (m_response.m_status < 200 && 101 != m_response.m_status)
+			continue;
+
+		auto request = std::move(m_in_flight.front());
+		m_in_flight.pop_front();
+		m_outstanding.fetch_sub(1, std::memory_order_relaxed);
+		bool keep_alive = m_response.m_keep_alive;
+		if (!keep_alive)
+			Retire(boost::asio::error::eof);
+		request.m_handler(boost::system::error_code(), m_response);
+		if (HasError())
+			return;
+		if (!keep_alive)
+		{
+			// Pipelined requests behind this one will not be answered
+			StartError(boost::asio::error::eof);
+			return;
+		}
+	}
+
+	StartRequests();
+	m_partial = position < size;
+	if (m_partial)
+		KeepRecv(offset + position, size - position);
+	DispatchRecv(0);
+}
+
+// HttpClientConnection::OnTimer definition
+void HttpClientConnection::OnTimer(const boost::posix_time::time_duration &/*delta*/)
+{
+	auto idle = GetHive()->GetTime() - m_last_activity;
+	if (m_connected && 0 == GetOutstandingCount() &&
+        idle > std::chrono::milliseconds(m_idle_timeout_ms))
+	{
+		Retire(boost::asio::error::timed_out);
+		StartError(boost::asio::error::timed_out);
+	}
+}
+
+// HttpClientConnection::OnError definition
+void HttpClientConnection::OnError(const boost::system::error_code &error)
+{
+	if (!m_close_buffer.empty() && boost::asio::error::eof == error && !m_in_flight.empty())
+	{
+		auto result = m_parser.ParseCloseDelimited(m_close_buffer.data(), m_close_buffer.size(), m_response);
+		auto request = std::move(m_in_flight.front());
+		m_in_flight.pop_front();
+		m_outstanding.fetch_sub(1, std::memory_order_relaxed);
+		if (HttpResponseParser::Result::complete == result)
+		{
+			++m_answered;
+			request.m_handler(boost::system::error_code(), m_response);
+		}
+		else
+			request.m_handler(boost::asio::error::invalid_argument, HttpResponse());
+	}
+	m_close_buffer.clear();
+	m_parser.Reset();
+	Retire(error);
+	Fail(error);
+}
+
+// HttpClient constructor
+HttpClient::HttpClient(std::shared_ptr<Hive> hive) :
+    m_hive(std::move(hive))
+{
+}
+
+// HttpClient destructor
+HttpClient::~HttpClient()
+{
+	Close();
+}
+
+// HttpClient::SetMaxConnectionsPerHost definition
+void HttpClient::SetMaxConnectionsPerHost(size_t max_connections)
+{
+	std::lock_guard lck(m_mutex);
+	m_max_connections = std::max<size_t>(1, max_connections);
+}
+
+// HttpClient::SetMaxPipelineDepth definition
+void HttpClient::SetMaxPipelineDepth(size_t max_pipeline_depth)
+{
+	std::lock_guard lck(m_mutex);
+	m_max_pipeline_depth = std::max<size_t>(1, max_pipeline_depth);
+}
+
+// HttpClient::SetIdleTimeout definition
+void HttpClient::SetIdleTimeout(int32_t idle_timeout_ms)
+{
+	std::lock_guard lck(m_mutex);
+	m_idle_timeout_ms = idle_timeout_ms;
+}
+
+// HttpClient::Get definition
+void HttpClient::Get(
+    const std::string &host,
+    uint16_t port,
+    std::string_view target,
+    handler_type handler
+)
+{
+	Request("GET", host, port, target, std::string_view(), std::string_view(), std::move(handler));
+}
+
+// HttpClient::Request definition
+void HttpClient::Request(
+    std::string_view method,
+    const std::string &host,
+    uint16_t port,
+    std::string_view target,
+    std::string_view headers,
+    std::string_view body,
+    handler_type handler
+)
+{
+	std::string port_text = std::to_string(port);
+	std::string length_text = std::to_string(body.size());
+
+	HttpClientConnection::Request request;
+	request.m_handler = std::move(handler);
+	request.m_head = "HEAD" == method;
+	request.m_idempotent = "GET" == method || "HEAD" == method || "PUT" == method ||
+        "DELETE" == method || "OPTIONS" == method || "TRACE" == method;
+	request.m_data = m_hive->GetBufferPool().Acquire(
+        method.size() + target.size() + host.size() + headers.size() + body.size() + 64
+    );
+	auto append = [&data=request.m_data](std::string_view text)
+	{
+		data.insert(data.end(), text.begin(), text.end());
+	};
+	append(method);
+	append(" ");
+	append(target.empty() ? "/" : target);
+	append(" HTTP/1.1\r\nHost: ");
+	append(host);
+	if (80 != port)
+	{
+		append(":");
+		append(port_text);
+	}
+	append(crlf);
+	append(headers);
+	if (!body.empty())
+	{
+		append("Content-Length: ");
+		append(length_text);
+		append(crlf);
+	}
+	append(crlf);
+	append(body);
+
+	Dispatch(host, port, std::move(request));
+}
+
+// HttpClient::GetConnectionCount definition
+size_t HttpClient::GetConnectionCount()
+{
+	std::lock_guard lck(m_mutex);
+	size_t count = 0;
+	for (auto &&host : m_hosts)
+		count += host.second.size();
+	return count;
+}
+
+// HttpClient::Close definition
+void HttpClient::Close()
+{
+	decltype(m_hosts) hosts;
+	{
+		std::lock_guard lck(m_mutex);
+		hosts.swap(m_hosts);
+	}
+	for (auto &&host : hosts)
+	{
+		for (auto &&connection : host.second)
+			connection->Disconnect();
+	}
+}
+
+// HttpClient::Dispatch definition
+void HttpClient::Dispatch(
+    const std::string &host,
+    uint16_t port,
+    HttpClientConnection::Request &&request
+)
+{
+	std::shared_ptr<HttpClientConnection> connection;
+	bool created = false;
+	{
+		std::lock_guard lck(m_mutex);
+		auto &&connections = m_hosts[host + ':' + std::to_string(port)];
+
+		HttpClientConnection *least_loaded = nullptr;
+		size_t least_count = 0;
+		for (auto &&candidate : connections)
+		{
+			size_t count = candidate->GetOutstandingCount();
+			if (candidate->IsReusable() && (!least_loaded || count < least_count))
+			{
+				least_loaded = candidate.get();
+				least_count = count;
+				if (0 == count)
+					break;
+			}
+		}
+
+		// An idle connection first, then a new one, then pipelining
+		if (!least_loaded || (least_count && connections.size() < m_max_connections))
+		{
+			connections.push_back(
+                std::make_shared<HttpClientConnection>(
+                    m_hive,
+                    weak_from_this(),
+                    host,
+                    port,
+                    m_max_pipeline_depth,
+                    m_idle_timeout_ms
+                )
+            );
+			created = true;
+			least_loaded = connections.back().get();
+		}
+		connection = std::static_pointer_cast<HttpClientConnection>(least_loaded->shared_from_this());
+
+		// Counted before the lock is released, so that the next request sees
+		// the connection busy
+		connection->Enqueue(std::move(request));
+	}
+
+	if (created)
+		connection->Connect(host, port);
+}
+
+// HttpClient::Remove definition
+void HttpClient::Remove(const std::string &key, HttpClientConnection *connection)
+{
+	std::lock_guard lck(m_mutex);
+	auto it = m_hosts.find(key);
+	if (it == m_hosts.end())
+		return;
+	auto &&connections = it->second;
+	connections.erase(
+        std::remove_if(
+            connections.begin(),
+            connections.end(),
+            [connection](auto &&candidate)
+            {
+                return candidate.get() == connection;
+            }
+        ),
+        connections.end()
+    );
+	if (connections.empty())
+		m_hosts.erase(it);
+}
+
+namespace
+{
+	// Returns the reason phrase sent with status
+	std::string_view StatusReason(int status)
+	{
+		switch (status)
+		{
+		case 100: return "Continue";
+		case 101: return "Switching Protocols";
+		case 200: return "OK";
+		case 201: return "Created";
+		case 202: return "Accepted";
+		case 204: return "No Content";
+		case 206: return "Partial Content";
+		case 301: return "Moved Permanently";
+		case 302: return "Found";
+		case 303: return "See Other";
+		case 304: return "Not Modified";
+		case 307: return "Temporary Redirect";
+		case 308: return "Permanent Redirect";
+		case 400: return "Bad Request";
+		case 401: return "Unauthorized";
+		case 403: return "Forbidden";
+		case 404: return "Not Found";
+		case 405: return "Method Not Allowed";
+		case 408: return "Request Timeout";
+		case 409: return "Conflict";
+		case 411: return "Length Required";
+		case 413: return "Payload Too Large";
+		case 414: return "URI Too Long";
+		case 429: return "Too Many Requests";
+		case 431: return "Request Header Fields Too Large";
+		case 500: return "Internal Server Error";
+		case 501: return "Not Implemented";
+		case 502: return "Bad Gateway";
+		case 503: return "Service Unavailable";
+		case 504: return "Gateway Timeout";
+		case 505: return "HTTP Version Not Supported";
+		default: return "Unknown";
+		}
+	}
+
+	// Returns the Date header line, formatted once per second and thread
+	std::string_view DateHeader()
+	{
+		thread_local char text[64];
+		thread_local size_t length = 0;
+		thread_local std::time_t formatted = -1;
+
+		std::time_t now = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+		if (now != formatted)
+		{
+			std::tm tm;
+			gmtime_r(&now, &tm);
+			length = std::strftime(text, sizeof(text), "Date: %a, %d %b %Y %H:%M:%S GMT\r\n", &tm);
+			formatted = now;
+		}
+		return std::string_view(text, length);
+	}
+
+	bool IsTokenChar(char c)
+	{
+		return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') ||
+            std::string_view("!#$%&'*+-.^_`|~").find(c) != std::string_view::npos;
+	}
+}
+
+// HttpRequest::GetHeader definition
+std::string_view HttpRequest::GetHeader(std::string_view name) const
+{
+	for (auto &&header : m_headers)
+	{
+		if (IEquals(header.m_name, name))
+			return header.m_value;
+	}
+	return std::string_view();
+}
+
+// HttpRequestParser::Parse definition
+HttpRequestParser::Result HttpRequestParser::Parse(
+    uint8_t *data,
+    size_t size,
+    HttpRequest &request,
+    size_t &consumed
+)
+{
+	if (!m_header_size)
+	{
+		size_t found = m_scanned + FindIn(data + m_scanned, size - m_scanned, crlfcrlf);
+		if (found == size)
+		{
+			if (size > m_max_header_size)
+				return Result::header_too_large;
+			// The last bytes may start the empty line
+			m_scanned = size - std::min(size, crlfcrlf.size() - 1);
+			return Result::incomplete;
+		}
+		m_header_size = found + crlfcrlf.size();
+		if (m_header_size > m_max_header_size)
+			return Result::header_too_large;
+		Result result = ParseHead(data, request);
+		if (Result::complete != result)
+			return result;
+		m_chunk_position = m_body_end = m_header_size;
+	}
+
+	switch (m_body)
+	{
+	case Body::none:
+		consumed = m_header_size;
+		m_body_end = m_header_size;
+		break;
+	case Body::length:
+		if (size - m_header_size < m_content_length)
+			return Result::incomplete;
+		consumed = m_header_size + m_content_length;
+		m_body_end = consumed;
+		break;
+	case Body::chunked:
+	{
+		Result result = DecodeChunks(
+            data,
+            size,
+            m_header_size,
+            m_max_body_size,
+            m_max_header_size,
+            m_chunk_position,
+            m_body_end,
+            consumed
+        );
+		if (Result::complete != result)
+			return result;
+		break;
+	}
+	}
+
+	// The views are taken again if the buffer moved since the headers
+	if (m_head_data != data && Result::error == ParseHead(data, request))
+		return Result::error;
+	request.m_body = std::string_view(
+        reinterpret_cast<const char *>(data + m_header_size),
+        m_body_end - m_header_size
+    );
+	return Result::complete;
+}
+
+// HttpRequestParser::Reset definition
+void HttpRequestParser::Reset()
+{
+	m_header_size = 0;
+	m_scanned = 0;
+	m_head_data = nullptr;
+	m_body = Body::none;
+	m_content_length = 0;
+	m_chunk_position = 0;
+	m_body_end = 0;
+	m_expect_continue = false;
+}
+
+// HttpRequestParser::ExpectsContinue definition
+bool HttpRequestParser::ExpectsContinue() const
+{
+	return m_header_size && m_expect_continue && Body::none != m_body;
+}
+
+// HttpRequestParser::SetMaxHeaderSize definition
+void HttpRequestParser::SetMaxHeaderSize(size_t max_header_size)
+{
+	m_max_header_size = max_header_size;
+}
+
+// HttpRequestParser::SetMaxBodySize definition
+void HttpRequestParser::SetMaxBodySize(size_t max_body_size)
+{
+	m_max_body_size = max_body_size;
+}
+
+// HttpRequestParser::ParseHead definition
+HttpRequestParser::Result HttpRequestParser::ParseHead(const uint8_t *data, HttpRequest &request)
+{
+	m_head_data = data;
+	std::string_view head(reinterpret_cast<const char *>(data), m_header_size);
+
+	// method SP request-target SP HTTP/1.x CRLF
+	size_t line_end = head.find(crlf);
+	std::string_view line = head.substr(0, line_end);
+	size_t method_end = line.find(' ');
+	if (std::string_view::npos == method_end || 0 == method_end)
+		return Result::error;
+	request.m_method = line.substr(0, method_end);
+	if (!std::all_of(request.m_method.begin(), request.m_method.end(), IsTokenChar))
+		return Result::error;
+
+	size_t target_end = line.find(' ', method_end + 1);
+	if (std::string_view::npos == target_end || method_end + 1 == target_end)
+		return Result::error;
+	request.m_target = line.substr(method_end + 1, target_end - method_end - 1);
+	std::string_view version = line.substr(target_end + 1);
+	if (version.size() != 8 || version.substr(0, 7) != "HTTP/1." || version[7] < '0' || version[7] > '9')
+		return Result::error;
+	request.m_version_minor = version[7] - '0';
+
+	size_t query = request.m_target.find('?');
+	request.m_path = request.m_target.substr(0, query);
+	request.m_query = std::string_view::npos == query ?
+        std::string_view() : request.m_target.substr(query + 1);
+
+	if (!ParseHeaderLines(head.substr(line_end + crlf.size()), request.m_headers))
+		return Result::error;
+
+	// A request with both Transfer-Encoding and Content-Length, or with a
+	// coding other than chunked, is rejected (RFC 7230 3.3.3)
+	bool has_length = false;
+	bool has_encoding = false;
+	bool chunked = false;
+	bool close = false;
+	bool keep_alive = false;
+	m_expect_continue = false;
+	for (auto &&header : request.m_headers)
+	{
+		if (IEquals(header.m_name, "Content-Length"))
+		{
+			uint64_t length = 0;
+			auto result = std::from_chars(
+                header.m_value.data(),
+                header.m_value.data() + header.m_value.size(),
+                length
+            );
+			if (result.ec != std::errc() || result.ptr != header.m_value.data() + header.m_value.size() ||
+                (has_length && length != m_content_length))
+				return Result::error;
+			has_length = true;
+			m_content_length = length;
+		}
+		else if (IEquals(header.m_name, "Transfer-Encoding"))
+		{
+			has_encoding = true;
+			chunked = IEquals(header.m_value, "chunked");
+		}
+		else if (IEquals(header.m_name, "Connection"))
+		{
+			close = close || HasToken(header.m_value, "close");
+			keep_alive = keep_alive || HasToken(header.m_value, "keep-alive");
+		}
+		else if (IEquals(header.m_name, "Expect"))
+		{
+			m_expect_continue = IEquals(header.m_value, "100-continue");
+		}
+	}
+
+	if (has_encoding && (!chunked || has_length))
+		return Result::error;
+	if (chunked)
+		m_body = Body::chunked;
+	else if (has_length && m_content_length)
+		m_body = Body::length;
+	else
+		m_body = Body::none;
+
+	if (Body::length == m_body && m_content_length > m_max_body_size)
+		return Result::body_too_large;
+
+	request.m_keep_alive = !close && (request.m_version_minor >= 1 || keep_alive);
+	return Result::complete;
+}
+
+// HttpResponseWriter::SetStatus definition
+void HttpResponseWriter::SetStatus(int status)
+{
+	m_status = status;
+}
+
+// HttpResponseWriter::SetHeaders definition
+void HttpResponseWriter::SetHeaders(std::string_view headers)
+{
+	m_headers = headers;
+}
+
+// HttpResponseWriter::AddHeader definition
+void HttpResponseWriter::AddHeader(std::string_view name, std::string_view value)
+{
+	m_extra_headers.append(name);
+	m_extra_headers.append(": ");
+	m_extra_headers.append(value);
+	m_extra_headers.append(crlf);
+}
+
+// HttpResponseWriter::SetBody definition
+void HttpResponseWriter::SetBody(std::string_view body)
+{
+	m_body = body;
+}
+
+// HttpResponseWriter::SetClose definition
+void HttpResponseWriter::SetClose(bool close)
+{
+	m_close = close;
+}
+
+// HttpResponseWriter::Reset definition
+void HttpResponseWriter::Reset(std::string_view default_headers)
+{
+	m_status = 200;
+	m_headers = default_headers;
+	m_extra_headers.clear();
+	m_body = std::string_view();
+	m_close = false;
+}
+
+// HttpServerConnection constructor
+HttpServerConnection::HttpServerConnection(std::shared_ptr<Hive> hive) :
+    Connection(hive),
+    m_last_activity(hive->GetTime())
+{
+	SetReceiveBufferSize(16 * 1024);
+}
+
+// HttpServerConnection::SetServer definition
+void HttpServerConnection::SetServer(std::shared_ptr<HttpServer> server)
+{
+	m_parser.SetMaxBodySize(server->m_max_body_size);
+	m_server = std::move(server);
+}
+
+// HttpServerConnection::Respond definition
+void HttpServerConnection::Respond(const HttpRequest &request)
+{
+	bool head = "HEAD" == request.m_method;
+	auto handler = m_server->FindRoute(request.m_method, request.m_path);
+	if (!handler && head)
+		handler = m_server->FindRoute("GET", request.m_path);
+
+	m_writer.Reset(m_server->m_default_headers);
+	if (handler)
+	{
+		(*handler)(request, m_writer);
+	}
+	else
+	{
+		m_writer.SetStatus(404);
+		m_writer.SetBody(StatusReason(404));
+	}
+
+	bool close = m_writer.m_close || !request.m_keep_alive;
+	std::string_view connection_header;
+	if (close)
+		connection_header = "Connection: close\r\n";
+	else if (0 == request.m_version_minor)
+		connection_header = "Connection: keep-alive\r\n";
+
+	AppendResponse(
+        m_writer.m_status,
+        m_writer.m_headers,
+        m_writer.m_extra_headers,
+        connection_header,
+        m_writer.m_body,
+        head
+    );
+	m_closing = m_closing || close;
+}
+
+// HttpServerConnection::RespondError definition
+void HttpServerConnection::RespondError(int status)
+{
+	AppendResponse(
+        status,
+        m_server->m_default_headers,
+        std::string_view(),
+        "Connection: close\r\n",
+        StatusReason(status),
+        false
+    );
+	m_closing = true;
+}
+
+// HttpServerConnection::AppendResponse definition
+void HttpServerConnection::AppendResponse(
+    int status,
+    std::string_view headers,
+    std::string_view extra_headers,
+    std::string_view connection_header,
+    std::string_view body,
+    bool head
+)
+{
+	if (m_output.empty())
+		m_output = GetHive()->GetBufferPool().Acquire(512 + body.size());
+
+	auto append = [this](std::string_view text)
+	{
+		m_output.insert(m_output.end(), text.begin(), text.end());
+	};
+	char number[24];
+
+	append("HTTP/1.1 ");
+	auto end = std::to_chars(number, number + sizeof(number), status).ptr;
+	append(std::string_view(number, end - number));
+	append(" ");
+	append(StatusReason(status));
+	append(crlf);
+	append(DateHeader());
+	append(headers);
+	append(extra_headers);
+	append(connection_header);
+	append("Content-Length: ");
+	end = std::to_chars(number, number + sizeof(number), body.size()).ptr;
+	append(std::string_view(number, end - number));
+	append(crlfcrlf);
+	if (!head)
+		append(body);
+}
+
+// HttpServerConnection::Flush definition
+void HttpServerConnection::Flush()
+{
+	if (m_output.empty())
+		return;
+	++m_pending_writes;
+	DispatchSend(std::move(m_output));
+	m_output = std::vector<uint8_t>();
+}
+
+// HttpServerConnection::Drain definition
+void HttpServerConnection::Drain()
+{
+	m_draining = true;
+	boost::system::error_code ec;
+	GetSocket().shutdown(boost::asio::ip::tcp::socket::shutdown_send, ec);
+}
+
+// HttpServerConnection::OnAccept definition
+void HttpServerConnection::OnAccept(const std::string &/*host*/, uint16_t /*port*/)
+{
+	Recv();
+}
+
+// HttpServerConnection::OnConnect definition
+void HttpServerConnection::OnConnect(const std::string &/*host*/, uint16_t /*port*/)
+{
+}
+
+// HttpServerConnection::OnSend definition
+void HttpServerConnection::OnSend(const std::vector<uint8_t> &/*buffer*/)
+{
+	--m_pending_writes;
+	if (m_closing && !m_draining && !m_pending_writes)
+		Drain();
+}
+
+// HttpServerConnection::OnRecv definition
+void HttpServerConnection::OnRecv(std::vector<uint8_t> &buffer)
+{
+	m_last_activity = GetHive()->GetTime();
+	if (m_closing)
+	{
+		// Whatever the client still sends after the last response is 
+		// discarded
+		DispatchRecv(0);
+		return;
+	}
+
+	size_t offset = GetRecvOffset();
+	uint8_t *data = buffer.data() + offset;
+	size_t size = buffer.size() - offset;
+	size_t position = 0;
+	while (position < size && !m_closing)
+	{
+		// Empty lines before a request are ignored (RFC 7230 3.5)
+		if (!m_request_started)
+		{
+			while (position + 1 < size && '\r' == data[position] && '\n' == data[position + 1])
+				position += crlf.size();
+			if (position == size)
+				break;
+		}
+
+		size_t consumed = 0;
+		auto result = m_parser.Parse(data + position, size - position, m_request, consumed);
+		if (HttpRequestParser::Result::header_too_large == result)
+		{
+			RespondError(431);
+			break;
+		}
+		if (HttpRequestParser::Result::body_too_large == result)
+		{
+			RespondError(413);
+			break;
+		}
+		if (HttpRequestParser::Result::error == result)
+		{
+			RespondError(400);
+			break;
+		}
+		if (HttpRequestParser::Result::incomplete == result)
+		{
+			m_request_started = true;
+			if (m_parser.ExpectsContinue() && !m_continue_sent)
+			{
+				if (m_output.empty())
+					m_output = GetHive()->GetBufferPool().Acquire(64);
+				std::string_view line = "HTTP/1.1 100 Continue\r\n\r\n";
+				m_output.insert(m_output.end(), line.begin(), line.end());
+				m_continue_sent = true;
+			}
+			break;
+		}
+
+		position += consumed;
+		m_parser.Reset();
+		m_request_started = false;
+		m_continue_sent = false;
+		Respond(m_request);
+		if (HasError())
+			return;
+	}
+
+	// The responses to every request of the chunk leave in one write
+	Flush();
+	if (m_closing)
+	{
+		if (!m_pending_writes)
+			Drain();
+	}
+	else if (position < size)
+	{
+		KeepRecv(offset + position, size - position);
+	}
+	DispatchRecv(0);
+}
+
+// HttpServerConnection::OnTimer definition
+void HttpServerConnection::OnTimer(const boost::posix_time::time_duration &/*delta*/)
+{
+	// A closing client gets a few seconds to read the last response
+	auto timeout = m_draining ?
+        std::chrono::milliseconds(5000) :
+        std::chrono::milliseconds(m_server->m_idle_timeout_ms);
+	if (GetHive()->GetTime() - m_last_activity > timeout)
+		StartError(boost::asio::error::timed_out);
+}
+
+// HttpServerConnection::OnError definition
+void HttpServerConnection::OnError(const boost::system::error_code &/*error*/)
+{
+}
+
+// HttpServerConnection::OnReset definition
+void HttpServerConnection::OnReset()
+{
+	m_server.reset();
+	m_parser.Reset();
+	m_writer.Reset(std::string_view());
+	if (!m_output.empty())
+		GetHive()->GetBufferPool().Release(std::move(m_output));
+	m_output = std::vector<uint8_t>();
+	m_pending_writes = 0;
+	m_last_activity = GetHive()->GetTime();
+	m_request_started = false;
+	m_continue_sent = false;
+	m_closing = false;
+	m_draining = false;
+}
+
+// HttpServer constructor
+HttpServer::HttpServer(std::shared_ptr<Hive> hive) :
+    Acceptor(hive),
+    m_pool(std::make_shared<ConnectionPool<HttpServerConnection> >(hive))
+{
+}
+
+// HttpServer::Route definition
+void HttpServer::Route(std::string_view method, std::string_view path, handler_type handler)
+{
+	auto table = std::find_if(
+        m_routes.begin(),
+        m_routes.end(),
+        [method](auto &&table)
+        {
+            return table.m_method == method;
+        }
+    );
+	if (table == m_routes.end())
+	{
+		m_routes.emplace_back();
+		table = std::prev(m_routes.end());
+		table->m_method = method;
+	}
+
+	auto it = table->m_handlers.find(path);
+	if (it != table->m_handlers.end())
+	{
+		it->second = std::move(handler);
+		return;
+	}
+	table->m_paths.emplace_back(path);
+	table->m_handlers.emplace(table->m_paths.back(), std::move(handler));
+}
+
+// HttpServer::SetDefaultHeaders definition
+void HttpServer::SetDefaultHeaders(std::string_view headers)
+{
+	m_default_headers = headers;
+}
+
+// HttpServer::SetIdleTimeout definition
+void HttpServer::SetIdleTimeout(int32_t idle_timeout_ms)
+{
+	m_idle_timeout_ms = idle_timeout_ms;
+}
+
+// HttpServer::SetMaxBodySize definition
+void HttpServer::SetMaxBodySize(size_t max_body_size)
+{
+	m_max_body_size = max_body_size;
+}
+
+// HttpServer::FindRoute definition
+const HttpServer::handler_type *HttpServer::FindRoute(std::string_view method, std::string_view path) const
+{
+	for (auto &&table : m_routes)
+	{
+		if (table.m_method != method)
+			continue;
+		auto it = table.m_handlers.find(path);
+		return it == table.m_handlers.end() ? nullptr : &it->second;
+	}
+	return nullptr;
+}
+
+// HttpServer::CreateConnection definition
+std::shared_ptr<Connection> HttpServer::CreateConnection()
+{
+	auto connection = m_pool->Acquire();
+	connection->SetServer(std::static_pointer_cast<HttpServer>(shared_from_this()));
+	return connection;
+}
+
+// HttpServer::OnAccept definition
+bool HttpServer::OnAccept(
+    std::shared_ptr<Connection> /*connection*/,
+    const std::string &/*host*/,
+    uint16_t /*port*/
+)
+{
+	return true;
+}
+
+// HttpServer::OnTimer definition
+void HttpServer::OnTimer(const boost::posix_time::time_duration &/*delta*/)
+{
+}
+
+// HttpServer::OnError definition
+void HttpServer::OnError(const boost::system::error_code &/*error*/)
+{
+}
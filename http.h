@@ -0,0 +1,486 @@
+/* http.h */
+#ifndef _HTTP_H_
+#define _HTTP_H_
+
+#include "wrapper.h"
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <unordered_map>
+#include <deque>
+
+class HttpClient;
+class HttpClientConnection;
+class HttpServer;
+class HttpServerConnection;
+
+// Outcome of the incremental HTTP parsers. HttpRequestParser reports a 
+// head or a body over its limits as header_too_large or body_too_large, 
+// so that the server answers 431 or 413; HttpResponseParser reports them
+// as error.
+enum class HttpParseResult { incomplete, complete, error, header_too_large, body_too_large };
+
+// Struct HttpHeader definition. Both views point into the receive buffer.
+struct HttpHeader
+{
+	std::string_view m_name;
+	std::string_view m_value;
+};
+
+// Struct HttpResponse definition. Every view points into the receive buffer
+// of the connection and is only valid during the handler call.
+struct HttpResponse
+{
+	int m_version_minor{1};
+	int m_status{0};
+	std::string_view m_reason;
+	std::vector<HttpHeader> m_headers;
+	std::string_view m_body;
+	bool m_keep_alive{false};
+
+	// Returns the value of the first header called name, compared case
+	// insensitively, or an empty view if there is none.
+	std::string_view GetHeader(std::string_view name) const;
+};
+
+// Class HttpResponseParser definition. Incremental HTTP/1.1 response parser
+// that works in place: the caller keeps the bytes of an incomplete response
+// and calls Parse again with more bytes appended. The buffer may move
+// between calls as long as the bytes keep their offsets from data. Bodies
+// with a Content-Length and chunked bodies are supported, the latter being
+// decoded in place. A body that ends with the connection is reported by
+// IsCloseDelimited, as only the caller sees the end of the stream.
+class HttpResponseParser
+{
+public:
+	using Result = HttpParseResult;
+
+	// Parses the response at the start of data, of which size bytes have
+	// been received. head_request tells that the response has no body
+	// whatever its headers say. Once complete, consumed is the size of the
+	// response in the buffer and response refers into data; call Reset
+	// before parsing the next response.
+	Result Parse(
+        uint8_t *data,
+        size_t size,
+        bool head_request,
+        HttpResponse &response,
+        size_t &consumed
+    );
+
+	// Parses a complete close delimited response of size bytes, where the
+	// body runs to the end of data.
+	Result ParseCloseDelimited(const uint8_t *data, size_t size, HttpResponse &response);
+
+	// Prepares the parser for the next response.
+	void Reset();
+
+	// Returns true once the headers of the current response have been
+	// parsed and its body ends with the connection.
+	bool IsCloseDelimited() const;
+
+	// Returns true if size bytes of a close delimited response, headers
+	// included, hold a body larger than the maximum.
+	bool IsCloseDelimitedTooLarge(size_t size) const;
+
+	// Sets the largest status line and headers accepted. The default value
+	// is 64 KiB.
+	void SetMaxHeaderSize(size_t max_header_size);
+
+	// Sets the largest body accepted. The default value is 64 MiB.
+	void SetMaxBodySize(size_t max_body_size);
+
+private:
+	enum class Body { none, length, chunked, close };
+
+	Result ParseHead(const uint8_t *data, bool head_request, HttpResponse &response);
+
+private:
+	size_t m_header_size{0};
+	size_t m_scanned{0};
+	// Buffer the views of the response were last taken from
+	const uint8_t *m_head_data{nullptr};
+	Body m_body{Body::none};
+	uint64_t m_content_length{0};
+	size_t m_chunk_position{0};
+	size_t m_body_end{0};
+	size_t m_max_header_size{64 * 1024};
+	size_t m_max_body_size{64 * 1024 * 1024};
+};
+
+// Class HttpClientConnection definition. One persistent HTTP/1.1 connection
+// of an HttpClient. Requests are written as soon as they are queued, up to
+// the pipeline depth of the client, and the responses are matched to them
+// in order. Used through HttpClient.
+class HttpClientConnection : public Connection
+{
+public:
+	using handler_type = std::function<
+        void(const boost::system::error_code &error, const HttpResponse &response)
+    >;
+
+	// Struct HttpClientConnection::Request definition. A serialized request
+	// and the handler of its response.
+	struct Request
+	{
+		std::vector<uint8_t> m_data;
+		handler_type m_handler;
+		bool m_head{false};
+		bool m_idempotent{false};
+	};
+
+	HttpClientConnection(
+        std::shared_ptr<Hive> hive,
+        std::weak_ptr<HttpClient> client,
+        const std::string &host,
+        uint16_t port,
+        size_t max_pipeline_depth,
+        int32_t idle_timeout_ms
+    );
+	~HttpClientConnection() override = default;
+
+	// Posts a request to the connection. This function is thread safe.
+	void Enqueue(Request &&request);
+
+	// Returns the number of requests queued or waiting for a response.
+	size_t GetOutstandingCount() const;
+
+	// Returns false once the connection will not take more requests.
+	bool IsReusable() const;
+
+private:
+	void StartRequests();
+	void Fail(const boost::system::error_code &error);
+	void Retire(const boost::system::error_code &error);
+	void FailCloseDelimited();
+
+	void OnAccept(const std::string &host, uint16_t port) override;
+	void OnConnect(const std::string &host, uint16_t port) override;
+	void OnSend(const std::vector<uint8_t> &buffer) override;
+	void OnRecv(std::vector<uint8_t> &buffer) final;
+	void OnTimer(const boost::posix_time::time_duration &delta) override;
+	void OnError(const boost::system::error_code &error) override;
+
+private:
+	std::weak_ptr<HttpClient> m_client;
+	std::string m_host;
+	uint16_t m_port;
+	std::string m_key;
+	size_t m_max_pipeline_depth;
+	int32_t m_idle_timeout_ms;
+	HttpResponseParser m_parser;
+	HttpResponse m_response;
+	RingQueue<Request> m_unsent;
+	RingQueue<Request> m_in_flight;
+	std::vector<uint8_t> m_close_buffer;
+	CoarseClock::clock_type::time_point m_last_activity;
+	size_t m_answered{0};
+	bool m_connected{false};
+	bool m_partial{false};
+	std::atomic<size_t> m_outstanding{0};
+	std::atomic<bool> m_reusable{true};
+};
+
+// Class HttpClient definition and its members declaration. HTTP/1.1 client
+// that keeps a pool of persistent connections per host and pipelines
+// requests on them. A request goes to an idle connection of its host if
+// there is one, else to a new connection while the host has fewer than the
+// maximum, else it is pipelined on the least loaded connection. Handlers
+// run on the strand of the connection. When a connection that has answered
+// requests closes, the requests that were not written yet move to another
+// connection, and so do the written idempotent requests whose response had
+// not started (RFC 7230 6.3.1). Other requests fail with the error. The
+// client must be owned by a std::shared_ptr.
+class HttpClient : public std::enable_shared_from_this<HttpClient>
+{
+	friend class HttpClientConnection;
+
+public:
+	using handler_type = HttpClientConnection::handler_type;
+
+	explicit HttpClient(std::shared_ptr<Hive> hive);
+	virtual ~HttpClient();
+
+	HttpClient(const HttpClient &rhs) = delete;
+	HttpClient &operator=(const HttpClient &rhs) = delete;
+
+	// Sets the number of connections opened to one host. The default value
+	// is 6.
+	void SetMaxConnectionsPerHost(size_t max_connections);
+
+	// Sets the number of requests written on a connection before their
+	// responses arrived. Further requests wait on the connection. The
+	// default value is 16; 1 disables pipelining.
+	void SetMaxPipelineDepth(size_t max_pipeline_depth);
+
+	// Sets the time after which a connection without requests is closed.
+	// The default value is 30 seconds.
+	void SetIdleTimeout(int32_t idle_timeout_ms);
+
+	// Sends a GET request for target, for instance "/index.html".
+	void Get(
+        const std::string &host,
+        uint16_t port,
+        std::string_view target,
+        handler_type handler
+    );
+
+	// Sends a request. headers holds additional header lines, each one
+	// ending with "\r\n". Host is always sent, and Content-Length is sent
+	// if body is not empty.
+	void Request(
+        std::string_view method,
+        const std::string &host,
+        uint16_t port,
+        std::string_view target,
+        std::string_view headers,
+        std::string_view body,
+        handler_type handler
+    );
+
+	// Returns the number of open connections over all hosts.
+	size_t GetConnectionCount();
+
+	// Disconnects every connection. Their outstanding requests fail.
+	void Close();
+
+private:
+	void Dispatch(
+        const std::string &host,
+        uint16_t port,
+        HttpClientConnection::Request &&request
+    );
+	void Remove(const std::string &key, HttpClientConnection *connection);
+
+private:
+	std::shared_ptr<Hive> m_hive;
+	std::mutex m_mutex;
+	std::unordered_map<std::string, std::vector<std::shared_ptr<HttpClientConnection> > > m_hosts;
+	size_t m_max_connections{6};
+	size_t m_max_pipeline_depth{16};
+	int32_t m_idle_timeout_ms{30000};
+};
+
+// Struct HttpRequest definition. Every view points into the receive buffer
+// of the connection and is only valid during the handler call.
+struct HttpRequest
+{
+	std::string_view m_method;
+	std::string_view m_target;
+	std::string_view m_path;
+	std::string_view m_query;
+	int m_version_minor{1};
+	std::vector<HttpHeader> m_headers;
+	std::string_view m_body;
+	bool m_keep_alive{false};
+
+	// Returns the value of the first header called name, compared case
+	// insensitively, or an empty view if there is none.
+	std::string_view GetHeader(std::string_view name) const;
+};
+
+// Class HttpRequestParser definition. Incremental HTTP/1.1 request parser
+// that works in place like HttpResponseParser. The header vector of the
+// request keeps its capacity, so a connection parses requests without 
+// allocating once it has seen the largest header count.
+class HttpRequestParser
+{
+public:
+	using Result = HttpParseResult;
+
+	// Parses the request at the start of data, of which size bytes have
+	// been received. Once complete, consumed is the size of the request in
+	// the buffer and request refers into data; call Reset before parsing 
+	// the next request.
+	Result Parse(uint8_t *data, size_t size, HttpRequest &request, size_t &consumed);
+
+	// Prepares the parser for the next request.
+	void Reset();
+
+	// Returns true once the headers of the current request have been 
+	// parsed and the client waits for 100 Continue before sending the body.
+	bool ExpectsContinue() const;
+
+	// Sets the largest request line and headers accepted. The default value
+	// is 16 KiB.
+	void SetMaxHeaderSize(size_t max_header_size);
+
+	// Sets the largest body accepted. The default value is 1 MiB.
+	void SetMaxBodySize(size_t max_body_size);
+
+private:
+	enum class Body { none, length, chunked };
+
+	Result ParseHead(const uint8_t *data, HttpRequest &request);
+
+private:
+	size_t m_header_size{0};
+	size_t m_scanned{0};
+	// Buffer the views of the request were last taken from
+	const uint8_t *m_head_data{nullptr};
+	Body m_body{Body::none};
+	uint64_t m_content_length{0};
+	size_t m_chunk_position{0};
+	size_t m_body_end{0};
+	bool m_expect_continue{false};
+	size_t m_max_header_size{16 * 1024};
+	size_t m_max_body_size{1024 * 1024};
+};
+
+// Class HttpResponseWriter definition. Collects the response of a handler.
+// The status line comes from a table, the headers given with SetHeaders 
+// are copied as they are, so that handlers pass header blocks serialized 
+// once, and Date, Content-Length and Connection are added by the server.
+class HttpResponseWriter
+{
+	friend class HttpServerConnection;
+
+public:
+	// Sets the status code. The default value is 200.
+	void SetStatus(int status);
+
+	// Replaces the server's default headers with headers, one or more lines
+	// each ending with "\r\n". The view must stay valid until the handler
+	// returns; a static string or a member of the handler does.
+	void SetHeaders(std::string_view headers);
+
+	// Adds one header line after the others.
+	void AddHeader(std::string_view name, std::string_view value);
+
+	// Sets the body. It is copied once into the output buffer after the
+	// handler returns, so the view only has to outlive the handler call.
+	void SetBody(std::string_view body);
+
+	// Closes the connection once the response has been sent.
+	void SetClose(bool close);
+
+private:
+	void Reset(std::string_view default_headers);
+
+private:
+	int m_status{200};
+	std::string_view m_headers;
+	std::string m_extra_headers;
+	std::string_view m_body;
+	bool m_close{false};
+};
+
+// Class HttpServerConnection definition. One connection of an HttpServer.
+// Every request of a received chunk is parsed and answered in turn, and the
+// responses to pipelined requests are gathered into one write. A response
+// that closes the connection stops the parsing; the connection then shuts
+// down its sending side and drains the client before it closes, so that 
+// the last response is not lost to a reset.
+class HttpServerConnection : public Connection
+{
+public:
+	HttpServerConnection(std::shared_ptr<Hive> hive);
+	~HttpServerConnection() override = default;
+
+	// Sets the server whose routes answer the requests.
+	void SetServer(std::shared_ptr<HttpServer> server);
+
+private:
+	void Respond(const HttpRequest &request);
+	void RespondError(int status);
+	void AppendResponse(
+        int status,
+        std::string_view headers,
+        std::string_view extra_headers,
+        std::string_view connection_header,
+        std::string_view body,
+        bool head
+    );
+	void Flush();
+	void Drain();
+
+	void OnAccept(const std::string &host, uint16_t port) override;
+	void OnConnect(const std::string &host, uint16_t port) override;
+	void OnSend(const std::vector<uint8_t> &buffer) override;
+	void OnRecv(std::vector<uint8_t> &buffer) final;
+	void OnTimer(const boost::posix_time::time_duration &delta) override;
+	void OnError(const boost::system::error_code &error) override;
+	void OnReset() override;
+
+private:
+	std::shared_ptr<HttpServer> m_server;
+	HttpRequestParser m_parser;
+	HttpRequest m_request;
+	HttpResponseWriter m_writer;
+	std::vector<uint8_t> m_output;
+	size_t m_pending_writes{0};
+	CoarseClock::clock_type::time_point m_last_activity;
+	bool m_request_started{false};
+	bool m_continue_sent{false};
+	bool m_closing{false};
+	bool m_draining{false};
+};
+
+// Class HttpServer definition and its members declaration. HTTP/1.1 server
+// on top of Acceptor with persistent connections and pipelining. Requests
+// are matched to routes by method and exact path, the query string left 
+// out, with one hash lookup that does not allocate. Handlers run on the
+// strand of the connection and answer before they return. Add the routes
+// before Accept is called; the table is read without a lock afterwards.
+// Connections are recycled through a ConnectionPool. The server must be 
+// owned by a std::shared_ptr.
+class HttpServer : public Acceptor
+{
+	friend class HttpServerConnection;
+
+public:
+	using handler_type = std::function<void(const HttpRequest &request, HttpResponseWriter &response)>;
+
+	explicit HttpServer(std::shared_ptr<Hive> hive);
+	~HttpServer() override = default;
+
+	// Answers requests for method and path with handler.
+	void Route(std::string_view method, std::string_view path, handler_type handler);
+
+	// Sets the header lines sent with every response whose handler does not
+	// call SetHeaders, each one ending with "\r\n". The default value is
+	// "Server: wrapper\r\nContent-Type: text/plain\r\n".
+	void SetDefaultHeaders(std::string_view headers);
+
+	// Sets the time after which a connection without requests is closed.
+	// The default value is 60 seconds.
+	void SetIdleTimeout(int32_t idle_timeout_ms);
+
+	// Sets the largest request body accepted. The default value is 1 MiB.
+	void SetMaxBodySize(size_t max_body_size);
+
+private:
+	const handler_type *FindRoute(std::string_view method, std::string_view path) const;
+
+	std::shared_ptr<Connection> CreateConnection() override;
+	bool OnAccept(
+        std::shared_ptr<Connection> connection,
+        const std::string &host,
+        uint16_t port
+    ) override;
+	void OnTimer(const boost::posix_time::time_duration &delta) override;
+	void OnError(const boost::system::error_code &error) override;
+
+private:
+	// Struct HttpServer::RouteTable definition. Paths of one method; the
+	// keys view into m_paths, which never moves its strings. The tables are
+	// kept in a deque for the same reason.
+	struct RouteTable
+	{
+		std::string m_method;
+		std::deque<std::string> m_paths;
+		std::unordered_map<std::string_view, handler_type> m_handlers;
+	};
+
+	std::shared_ptr<ConnectionPool<HttpServerConnection> > m_pool;
+	std::deque<RouteTable> m_routes;
+	std::string m_default_headers{"Server: wrapper\r\nContent-Type: text/plain\r\n"};
+	int32_t m_idle_timeout_ms{60000};
+	size_t m_max_body_size{1024 * 1024};
+};
+
+#endif // _HTTP_H_
@@ -0,0 +1,313 @@
+/* httpbench.cpp */
+#include "http.h"
+#include <boost/current_function.hpp>
+#include <iostream>
+#include <chrono>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <string>
+#include <cstdlib>
+#include <cstdio>
+#include <cmath>
+#include <algorithm>
+
+// Throughput benchmark for HttpServer in the manner of wrk. A number of
+// connections each keep a fixed number of pipelined GET requests in flight
+// over loopback and count the responses, which they parse with
+// HttpResponseParser. With a pipeline depth of 1 every connection waits for
+// the response before it sends the next request, as wrk does without a
+// pipelining script.
+//
+// With port 0 an HttpServer is started in-process on an ephemeral port
+// with one SO_REUSEPORT listener per thread, answering /plaintext with
+// "Hello, World!".
+//
+// usage: httpbench [connections] [pipeline depth] [seconds] [threads]
+//                  [port, 0 = in-process server] [path]
+
+using Clock = std::chrono::steady_clock;
+
+struct Options
+{
+    size_t m_connections{64};
+    size_t m_pipeline{16};
+    size_t m_seconds{10};
+    size_t m_threads{0};
+    uint16_t m_port{0};
+    std::string m_path{"/plaintext"};
+    std::chrono::seconds m_warmup{1};
+};
+
+// Results of the connections of one Hive. A HivePool runs every Hive on
+// exactly one thread, so the connections of a Hive update their Stats
+// without synchronization.
+struct Stats
+{
+    uint64_t m_requests{0};
+    uint64_t m_bytes{0};
+    uint64_t m_errors{0};
+    uint64_t m_non_2xx{0};
+    double m_latency_sum{0.0};
+    double m_latency_square_sum{0.0};
+    double m_latency_max{0.0};
+    size_t m_connected{0};
+};
+
+// Measurement window shared by every client connection. It is written
+// before the Hive threads start and only read afterwards.
+struct Window
+{
+    Clock::time_point m_start;
+    Clock::time_point m_end;
+};
+
+class BenchConnection : public Connection
+{
+public:
+    BenchConnection(
+        std::shared_ptr<Hive> hive,
+        const Options &options,
+        const std::string &request,
+        const Window &window,
+        Stats &stats,
+        std::atomic<bool> &running
+    ) :
+        Connection(hive),
+        m_options(options),
+        m_request(request),
+        m_window(window),
+        m_stats(stats),
+        m_running(running)
+    {
+        SetReceiveBufferSize(64 * 1024);
+    }
+
+    ~BenchConnection() override = default;
+
+private:
+    void OnAccept(const std::string &host, uint16_t port) override
+    {
+    }
+
+    void OnConnect(const std::string &host, uint16_t port) override
+    {
+        ++m_stats.m_connected;
+        Recv();
+        SendRequests(m_options.m_pipeline, Clock::now());
+    }
+
+    void OnSend(const std::vector<uint8_t> &buffer) override
+    {
+    }
+
+    void OnRecv(std::vector<uint8_t> &buffer) override
+    {
+        auto now = Clock::now();
+        bool measured = now >= m_window.m_start && now < m_window.m_end;
+        size_t offset = GetRecvOffset();
+        uint8_t *data = buffer.data() + offset;
+        size_t size = buffer.size() - offset;
+        size_t position = 0;
+        size_t completed = 0;
+        while (position < size)
+        {
+            size_t consumed = 0;
+            auto result = m_parser.Parse(data + position, size - position, false, m_response, consumed);
+            if (HttpResponseParser::Result::error == result)
+            {
+                ++m_stats.m_errors;
+                Disconnect();
+                return;
+            }
+            if (HttpResponseParser::Result::incomplete == result)
+                break;
+
+            m_parser.Reset();
+            position += consumed;
+            ++completed;
+            if (measured)
+            {
+                double latency = std::chrono::duration<double, std::micro>(now - m_sent.front()).count();
+                ++m_stats.m_requests;
+                m_stats.m_bytes += consumed;
+                m_stats.m_latency_sum += latency;
+                m_stats.m_latency_square_sum += latency * latency;
+                m_stats.m_latency_max = std::max(m_stats.m_latency_max, latency);
+                if (m_response.m_status < 200 || m_response.m_status >= 300)
+                    ++m_stats.m_non_2xx;
+            }
+            m_sent.pop_front();
+        }
+
+        if (position < size)
+            KeepRecv(offset + position, size - position);
+        Recv();
+
+        // Every response releases the next request, sent in one write
+        SendRequests(completed, now);
+    }
+
+    void OnTimer(const boost::posix_time::time_duration &delta) override
+    {
+    }
+
+    void OnError(const boost::system::error_code &error) override
+    {
+        if (m_running.load(std::memory_order_relaxed))
+            ++m_stats.m_errors;
+    }
+
+    void SendRequests(size_t count, Clock::time_point now)
+    {
+        if (!count || !m_running.load(std::memory_order_relaxed))
+            return;
+
+        auto buffer = GetHive()->GetBufferPool().Acquire(m_request.size() * count);
+        for (size_t i = 0; i != count; ++i)
+        {
+            buffer.insert(buffer.end(), m_request.begin(), m_request.end());
+            m_sent.push_back(now);
+        }
+        Send(std::move(buffer));
+    }
+
+private:
+    const Options &m_options;
+    const std::string &m_request;
+    const Window &m_window;
+    Stats &m_stats;
+    std::atomic<bool> &m_running;
+    HttpResponseParser m_parser;
+    HttpResponse m_response;
+    RingQueue<Clock::time_point> m_sent;
+};
+
+int main(int argc, char *argv[])
+{
+    Options options;
+    if (argc > 1)
+        options.m_connections = std::strtoull(argv[1], nullptr, 10);
+    if (argc > 2)
+        options.m_pipeline = std::max<size_t>(1, std::strtoull(argv[2], nullptr, 10));
+    if (argc > 3)
+        options.m_seconds = std::strtoull(argv[3], nullptr, 10);
+    if (argc > 4)
+        options.m_threads = std::strtoull(argv[4], nullptr, 10);
+    if (argc > 5)
+        options.m_port = static_cast<uint16_t>(std::strtoul(argv[5], nullptr, 10));
+    if (argc > 6)
+        options.m_path = argv[6];
+
+    // The in-process server gets its own threads, so that the client
+    // measures the server and not its own scheduling
+    std::unique_ptr<HivePool> server_pool;
+    std::vector<std::shared_ptr<HttpServer> > servers;
+    uint16_t port = options.m_port;
+    if (0 == port)
+    {
+        static const std::string hello = "Hello, World!";
+        server_pool = std::make_unique<HivePool>(options.m_threads);
+        for (size_t i = 0; i != server_pool->GetSize(); ++i)
+        {
+            auto server = std::make_shared<HttpServer>(server_pool->GetHive(i));
+            server->Route(
+                "GET",
+                "/plaintext",
+                [](const HttpRequest &request, HttpResponseWriter &response)
+                {
+                    response.SetBody(hello);
+                }
+            );
+            server->SetReusePort(true);
+            server->SetPendingAccepts(16);
+            server->Listen("127.0.0.1", port);
+            server->Accept();
+            port = server->GetAcceptor().local_endpoint().port();
+            servers.emplace_back(std::move(server));
+        }
+        server_pool->Run();
+    }
+
+    std::string request = "GET " + options.m_path + " HTTP/1.1\r\nHost: 127.0.0.1:" +
+        std::to_string(port) + "\r\n\r\n";
+
+    HivePool pool(options.m_threads);
+    std::vector<Stats> stats(pool.GetSize());
+    std::atomic<bool> running{true};
+    Window window;
+    window.m_start = Clock::now() + options.m_warmup;
+    window.m_end = window.m_start + std::chrono::seconds(options.m_seconds);
+
+    std::cout << BOOST_CURRENT_FUNCTION << " http://127.0.0.1:" << port << options.m_path
+              << ", " << options.m_connections << " connections, pipeline depth "
+              << options.m_pipeline << ", " << options.m_seconds << " s after "
+              << options.m_warmup.count() << " s of warmup, " << pool.GetSize()
+              << " threads\n";
+
+    std::vector<std::shared_ptr<BenchConnection> > connections;
+    connections.reserve(options.m_connections);
+    for (size_t i = 0; i != options.m_connections; ++i)
+    {
+        size_t index = i % pool.GetSize();
+        auto connection = std::make_shared<BenchConnection>(
+            pool.GetHive(index), options, request, window, stats[index], running
+        );
+        connection->Connect("127.0.0.1", port);
+        connections.emplace_back(std::move(connection));
+    }
+
+    pool.Run();
+    std::this_thread::sleep_until(window.m_end);
+    running = false;
+
+    for (auto &&connection : connections)
+        connection->Disconnect();
+    pool.Stop();
+
+    for (auto &&server : servers)
+        server->Stop();
+    if (server_pool)
+        server_pool->Stop();
+
+    Stats total;
+    for (auto &&hive_stats : stats)
+    {
+        total.m_requests += hive_stats.m_requests;
+        total.m_bytes += hive_stats.m_bytes;
+        total.m_errors += hive_stats.m_errors;
+        total.m_non_2xx += hive_stats.m_non_2xx;
+        total.m_latency_sum += hive_stats.m_latency_sum;
+        total.m_latency_square_sum += hive_stats.m_latency_square_sum;
+        total.m_latency_max = std::max(total.m_latency_max, hive_stats.m_latency_max);
+        total.m_connected += hive_stats.m_connected;
+    }
+
+    double seconds = std::chrono::duration<double>(window.m_end - window.m_start).count();
+    double mean = total.m_requests ? total.m_latency_sum / total.m_requests : 0.0;
+    double variance = total.m_requests ?
+        total.m_latency_square_sum / total.m_requests - mean * mean : 0.0;
+
+    char line[160];
+    std::snprintf(
+        line, sizeof(line),
+        "  latency us: avg %.1f, stdev %.1f, max %.1f\n"
+        "  %llu requests in %.1f s, %.1f MB read\n",
+        mean, std::sqrt(std::max(0.0, variance)), total.m_latency_max,
+        static_cast<unsigned long long>(total.m_requests), seconds, total.m_bytes / 1e6
+    );
+    std::cout << line;
+    if (total.m_errors || total.m_non_2xx || total.m_connected != options.m_connections)
+    {
+        std::cout << "  connected: " << total.m_connected << '/' << options.m_connections
+                  << ", errors: " << total.m_errors << ", non-2xx responses: "
+                  << total.m_non_2xx << '\n';
+    }
+    std::snprintf(
+        line, sizeof(line), "Requests/sec: %.0f\nTransfer/sec: %.2f MB\n",
+        total.m_requests / seconds, total.m_bytes / seconds / 1e6
+    );
+    std::cout << line;
+
+    return 0;
+}
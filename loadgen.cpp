@@ -0,0 +1,608 @@
+/* loadgen.cpp */
+#include "wrapper.h"
+#include <boost/current_function.hpp>
+#include <iostream>
+#include <chrono>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <string>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+// Echo load generator for the wrapper. Opens a number of Connection
+// objects to an echo server over loopback and measures the round trip of
+// fixed size messages.
+//
+// In closed loop mode (rate 0) every connection keeps one message in
+// flight and sends the next one as soon as the echo is complete. In open
+// loop mode every connection sends at a fixed rate whatever the server
+// does, and the latency is measured from the time the message should have
+// been sent, so that a stalled server is not hidden by the client waiting
+// for it (coordinated omission).
+//
+// With port 0 an echo server is started in-process on an ephemeral port.
+// echoserver logs every message, so it is only useful with low rates.
+//
+// usage: loadgen [connections] [message bytes] [rate msgs/s per connection, 0 = closed loop]
+//                [seconds] [threads] [port, 0 = in-process server] [text|json]
+
+using Clock = std::chrono::steady_clock;
+
+// Log-linear histogram of nanosecond values with three significant
+// decimal digits, in the manner of HdrHistogram. Values above the highest
+// trackable value are clamped to it.
+class HdrHistogram
+{
+public:
+    static constexpr uint64_t sub_bucket_count = 2048;
+    static constexpr uint64_t sub_bucket_half_count = sub_bucket_count / 2;
+    static constexpr unsigned max_shift = 30;
+
+    HdrHistogram() :
+        m_counts(sub_bucket_count + max_shift * sub_bucket_half_count, 0)
+    {
+    }
+
+    void Record(uint64_t value)
+    {
+        value = std::min<uint64_t>(value, (sub_bucket_count << max_shift) - 1);
+        ++m_counts[IndexOf(value)];
+        ++m_total_count;
+        m_max = std::max(m_max, value);
+        m_min = std::min(m_min, value);
+    }
+
+    void Add(const HdrHistogram &other)
+    {
+        for (size_t i = 0; i != m_counts.size(); ++i)
+            m_counts[i] += other.m_counts[i];
+        m_total_count += other.m_total_count;
+        m_max = std::max(m_max, other.m_max);
+        m_min = std::min(m_min, other.m_min);
+    }
+
+    uint64_t GetTotalCount() const
+    {
+        return m_total_count;
+    }
+
+    uint64_t GetMax() const
+    {
+        return m_total_count ? m_max : 0;
+    }
+
+    uint64_t GetMin() const
+    {
+        return m_total_count ? m_min : 0;
+    }
+
+    double GetMean() const
+    {
+        if (!m_total_count)
+            return 0.0;
+        double sum = 0.0;
+        for (size_t i = 0; i != m_counts.size(); ++i)
+            sum += static_cast<double>(m_counts[i]) * (LowestOf(i) + HighestOf(i)) / 2;
+        return sum / m_total_count;
+    }
+
+    // Returns the highest value that is equivalent to the value below which
+    // percentile percent of the recorded values fall.
+    uint64_t GetValueAtPercentile(double percentile) const
+    {
+        if (!m_total_count)
+            return 0;
+        auto wanted = static_cast<uint64_t>(std::ceil(percentile / 100.0 * m_total_count));
+        wanted = std::clamp<uint64_t>(wanted, 1, m_total_count);
+        uint64_t count = 0;
+        for (size_t i = 0; i != m_counts.size(); ++i)
+        {
+            count += m_counts[i];
+            if (count >= wanted)
+                return std::min(HighestOf(i), m_max);
+        }
+        return m_max;
+    }
+
+    // Calls handler(value, percentile, total_count) for the percentiles of
+    // a classic HdrHistogram percentile distribution: ticks_per_half ticks
+    // for every halving of the distance to 100 %, up to the maximum.
+    template<class Handler>
+    void ForEachPercentile(unsigned ticks_per_half, Handler handler) const
+    {
+        if (!m_total_count)
+            return;
+        for (unsigned tick = 0; ; ++tick)
+        {
+            double percentile = 100.0 * (1.0 - std::pow(0.5, static_cast<double>(tick) / ticks_per_half));
+            uint64_t value = GetValueAtPercentile(percentile);
+            if (value >= m_max || 100.0 - percentile < 100.0 / m_total_count)
+                break;
+            handler(value, percentile, CountAtOrBelow(value));
+        }
+        handler(m_max, 100.0, m_total_count);
+    }
+
+private:
+    static size_t IndexOf(uint64_t value)
+    {
+        if (value < sub_bucket_count)
+            return static_cast<size_t>(value);
+        unsigned shift = 1;
+        while (value >> (shift + 11))
+            ++shift;
+        return static_cast<size_t>(
+            sub_bucket_count + (shift - 1) * sub_bucket_half_count +
+            ((value >> shift) - sub_bucket_half_count)
+        );
+    }
+
+    static uint64_t LowestOf(size_t index)
+    {
+        if (index < sub_bucket_count)
+            return index;
+        uint64_t shift = (index - sub_bucket_count) / sub_bucket_half_count + 1;
+        uint64_t sub_bucket = (index - sub_bucket_count) % sub_bucket_half_count + sub_bucket_half_count;
+        return sub_bucket << shift;
+    }
+
+    static uint64_t HighestOf(size_t index)
+    {
+        if (index < sub_bucket_count)
+            return index;
+        uint64_t shift = (index - sub_bucket_count) / sub_bucket_half_count + 1;
+        return LowestOf(index) + (uint64_t(1) << shift) - 1;
+    }
+
+    uint64_t CountAtOrBelow(uint64_t value) const
+    {
+        uint64_t count = 0;
+        for (size_t i = 0, end = IndexOf(value); i <= end; ++i)
+            count += m_counts[i];
+        return count;
+    }
+
+private:
+    std::vector<uint64_t> m_counts;
+    uint64_t m_total_count{0};
+    uint64_t m_max{0};
+    uint64_t m_min{~uint64_t(0)};
+};
+
+struct Options
+{
+    size_t m_connections{100};
+    size_t m_message_size{64};
+    double m_rate{0.0};
+    size_t m_seconds{10};
+    size_t m_threads{0};
+    uint16_t m_port{0};
+    bool m_json{false};
+    std::chrono::seconds m_warmup{1};
+};
+
+// Results of the connections of one Hive. A HivePool runs every Hive on
+// exactly one thread, so the connections of a Hive update their Stats
+// without synchronization.
+struct Stats
+{
+    HdrHistogram m_latency;
+    uint64_t m_messages{0};
+    uint64_t m_bytes{0};
+    uint64_t m_errors{0};
+    size_t m_connected{0};
+};
+
+// Measurement window shared by every client connection. It is written
+// before the Hive threads start and only read afterwards.
+struct Window
+{
+    Clock::time_point m_start;
+    Clock::time_point m_end;
+};
+
+class EchoConnection : public Connection
+{
+public:
+    EchoConnection(std::shared_ptr<Hive> hive) :
+        Connection(hive)
+    {
+    }
+
+    ~EchoConnection() override = default;
+
+private:
+    void OnAccept(const std::string &host, uint16_t port) override
+    {
+        Recv();
+    }
+
+    void OnConnect(const std::string &host, uint16_t port) override
+    {
+    }
+
+    void OnSend(const std::vector<uint8_t> &buffer) override
+    {
+    }
+
+    void OnRecv(std::vector<uint8_t> &buffer) override
+    {
+        Recv();
+        Send(std::move(buffer));
+    }
+
+    void OnTimer(const boost::posix_time::time_duration &delta) override
+    {
+    }
+
+    void OnError(const boost::system::error_code &error) override
+    {
+    }
+};
+
+class EchoAcceptor : public Acceptor
+{
+public:
+    EchoAcceptor(std::shared_ptr<Hive> hive) :
+        Acceptor(hive),
+        m_pool(std::make_shared<ConnectionPool<EchoConnection> >(hive))
+    {}
+
+    ~EchoAcceptor() override = default;
+
+private:
+    std::shared_ptr<Connection> CreateConnection() override
+    {
+        return m_pool->Acquire();
+    }
+
+    bool OnAccept(
+        std::shared_ptr<Connection> connection,
+        const std::string &host,
+        uint16_t port
+    ) override
+    {
+        return true;
+    }
+
+    void OnTimer(const boost::posix_time::time_duration &delta) override
+    {
+    }
+
+    void OnError(const boost::system::error_code &error) override
+    {
+    }
+
+private:
+    std::shared_ptr<ConnectionPool<EchoConnection> > m_pool;
+};
+
+class LoadConnection : public Connection
+{
+public:
+    LoadConnection(
+        std::shared_ptr<Hive> hive,
+        const Options &options,
+        const Window &window,
+        Stats &stats,
+        std::atomic<bool> &running
+    ) :
+        Connection(hive),
+        m_options(options),
+        m_window(window),
+        m_stats(stats),
+        m_running(running),
+        m_timer(hive->GetContext())
+    {
+        if (m_options.m_rate > 0.0)
+        {
+            m_interval = std::chrono::duration_cast<Clock::duration>(
+                std::chrono::duration<double>(1.0 / m_options.m_rate)
+            );
+        }
+    }
+
+    ~LoadConnection() override = default;
+
+private:
+    void OnAccept(const std::string &host, uint16_t port) override
+    {
+    }
+
+    void OnConnect(const std::string &host, uint16_t port) override
+    {
+        ++m_stats.m_connected;
+        Recv();
+
+        if (m_interval.count())
+        {
+            m_next_send = Clock::now();
+            SendDue();
+        }
+        else
+        {
+            SendMessage(Clock::now());
+        }
+    }
+
+    void OnSend(const std::vector<uint8_t> &buffer) override
+    {
+    }
+
+    void OnRecv(std::vector<uint8_t> &buffer) override
+    {
+        auto now = Clock::now();
+        m_received += buffer.size();
+        while (m_received >= m_options.m_message_size && !m_intended.empty())
+        {
+            m_received -= m_options.m_message_size;
+            auto intended = m_intended.front();
+            m_intended.pop_front();
+
+            if (now >= m_window.m_start && now < m_window.m_end)
+            {
+                auto latency = std::chrono::duration_cast<std::chrono::nanoseconds>(now - intended);
+                m_stats.m_latency.Record(static_cast<uint64_t>(latency.count()));
+                ++m_stats.m_messages;
+                m_stats.m_bytes += m_options.m_message_size;
+            }
+
+            // Closed loop: the completed echo releases the next message
+            if (!m_interval.count())
+                SendMessage(now);
+        }
+
+        Recv();
+    }
+
+    void OnTimer(const boost::posix_time::time_duration &delta) override
+    {
+    }
+
+    void OnError(const boost::system::error_code &error) override
+    {
+        if (m_running.load(std::memory_order_relaxed))
+            ++m_stats.m_errors;
+        boost::system::error_code ec;
+        m_timer.cancel(ec);
+    }
+
+    void SendMessage(Clock::time_point intended)
+    {
+        if (!m_running.load(std::memory_order_relaxed))
+            return;
+
+        auto buffer = GetHive()->GetBufferPool().Acquire(m_options.m_message_size);
+        buffer.resize(m_options.m_message_size, 'x');
+        m_intended.push_back(intended);
+        Send(std::move(buffer));
+    }
+
+    // Sends every message whose scheduled time has passed, including the
+    // ones a late timer missed, then waits for the next one.
+    void SendDue()
+    {
+        if (!m_running.load(std::memory_order_relaxed) || HasError())
+            return;
+
+        auto now = Clock::now();
+        while (m_next_send <= now)
+        {
+            SendMessage(m_next_send);
+            m_next_send += m_interval;
+        }
+
+        m_timer.expires_at(m_next_send);
+        m_timer.async_wait(
+            boost::asio::bind_executor(
+                GetStrand(),
+                [self=shared_from_this(),this](auto &&ec)
+                {
+                    if (!ec)
+                        SendDue();
+                }
+            )
+        );
+    }
+
+private:
+    const Options &m_options;
+    const Window &m_window;
+    Stats &m_stats;
+    std::atomic<bool> &m_running;
+    boost::asio::steady_timer m_timer;
+    Clock::duration m_interval{0};
+    Clock::time_point m_next_send;
+    RingQueue<Clock::time_point> m_intended;
+    size_t m_received{0};
+};
+
+void PrintText(const Options &options, const Stats &total, std::chrono::duration<double> elapsed)
+{
+    auto &&latency = total.m_latency;
+    double seconds = elapsed.count();
+
+    std::cout << "connected: " << total.m_connected << '/' << options.m_connections
+              << ", errors: " << total.m_errors << '\n'
+              << "msgs/s: " << static_cast<uint64_t>(total.m_messages / seconds) << '\n'
+              << "MB/s: " << total.m_bytes / seconds / 1e6 << '\n'
+              << "latency us: min " << latency.GetMin() / 1e3
+              << ", mean " << latency.GetMean() / 1e3
+              << ", p50 " << latency.GetValueAtPercentile(50.0) / 1e3
+              << ", p99 " << latency.GetValueAtPercentile(99.0) / 1e3
+              << ", p99.9 " << latency.GetValueAtPercentile(99.9) / 1e3
+              << ", max " << latency.GetMax() / 1e3 << "\n\n";
+
+    std::cout << "       Value(us)   Percentile   TotalCount 1/(1-Percentile)\n\n";
+    latency.ForEachPercentile(
+        5,
+        [](uint64_t value, double percentile, uint64_t count)
+        {
+            char line[96];
+            if (percentile < 100.0)
+            {
+                std::snprintf(
+                    line, sizeof(line), "%16.3f %12.6f %12llu %14.2f\n",
+                    value / 1e3, percentile / 100.0,
+                    static_cast<unsigned long long>(count),
+                    1.0 / (1.0 - percentile / 100.0)
+                );
+            }
+            else
+            {
+                std::snprintf(
+                    line, sizeof(line), "%16.3f %12.6f %12llu\n",
+                    value / 1e3, 1.0, static_cast<unsigned long long>(count)
+                );
+            }
+            std::cout << line;
+        }
+    );
+}
+
+void PrintJson(const Options &options, const Stats &total, std::chrono::duration<double> elapsed)
+{
+    auto &&latency = total.m_latency;
+    double seconds = elapsed.count();
+
+    std::cout << "{\n"
+              << "  \"connections\": " << options.m_connections << ",\n"
+              << "  \"connected\": " << total.m_connected << ",\n"
+              << "  \"message_bytes\": " << options.m_message_size << ",\n"
+              << "  \"mode\": \"" << (options.m_rate > 0.0 ? "open" : "closed") << "\",\n"
+              << "  \"rate_per_connection\": " << options.m_rate << ",\n"
+              << "  \"seconds\": " << seconds << ",\n"
+              << "  \"errors\": " << total.m_errors << ",\n"
+              << "  \"messages\": " << total.m_messages << ",\n"
+              << "  \"msgs_per_sec\": " << total.m_messages / seconds << ",\n"
+              << "  \"mb_per_sec\": " << total.m_bytes / seconds / 1e6 << ",\n"
+              << "  \"latency_ns\": {\n"
+              << "    \"min\": " << latency.GetMin() << ",\n"
+              << "    \"mean\": " << latency.GetMean() << ",\n"
+              << "    \"p50\": " << latency.GetValueAtPercentile(50.0) << ",\n"
+              << "    \"p99\": " << latency.GetValueAtPercentile(99.0) << ",\n"
+              << "    \"p999\": " << latency.GetValueAtPercentile(99.9) << ",\n"
+              << "    \"max\": " << latency.GetMax() << "\n"
+              << "  },\n"
+              << "  \"histogram\": [";
+
+    const char *separator = "\n";
+    latency.ForEachPercentile(
+        5,
+        [&separator](uint64_t value, double percentile, uint64_t count)
+        {
+            std::cout << separator << "    {\"value_ns\": " << value
+                      << ", \"percentile\": " << percentile
+                      << ", \"count\": " << count << '}';
+            separator = ",\n";
+        }
+    );
+    std::cout << "\n  ]\n}\n";
+}
+
+int main(int argc, char *argv[])
+{
+    Options options;
+    if (argc > 1)
+        options.m_connections = std::strtoull(argv[1], nullptr, 10);
+    if (argc > 2)
+        options.m_message_size = std::max<size_t>(1, std::strtoull(argv[2], nullptr, 10));
+    if (argc > 3)
+        options.m_rate = std::strtod(argv[3], nullptr);
+    if (argc > 4)
+        options.m_seconds = std::strtoull(argv[4], nullptr, 10);
+    if (argc > 5)
+        options.m_threads = std::strtoull(argv[5], nullptr, 10);
+    if (argc > 6)
+        options.m_port = static_cast<uint16_t>(std::strtoul(argv[6], nullptr, 10));
+    if (argc > 7)
+        options.m_json = 0 == std::strcmp(argv[7], "json");
+
+    // The in-process server gets its own threads, so that the client
+    // measures the round trip and not its own scheduling
+    std::unique_ptr<HivePool> server_pool;
+    std::vector<std::shared_ptr<EchoAcceptor> > acceptors;
+    uint16_t port = options.m_port;
+    if (0 == port)
+    {
+        server_pool = std::make_unique<HivePool>(options.m_threads);
+        for (size_t i = 0; i != server_pool->GetSize(); ++i)
+        {
+            auto acceptor = std::make_shared<EchoAcceptor>(server_pool->GetHive(i));
+            acceptor->SetReusePort(true);
+            acceptor->SetPendingAccepts(16);
+            acceptor->Listen("127.0.0.1", port);
+            acceptor->Accept();
+            port = acceptor->GetAcceptor().local_endpoint().port();
+            acceptors.emplace_back(std::move(acceptor));
+        }
+        server_pool->Run();
+    }
+
+    HivePool pool(options.m_threads);
+    std::vector<Stats> stats(pool.GetSize());
+    std::atomic<bool> running{true};
+    Window window;
+    window.m_start = Clock::now() + options.m_warmup;
+    window.m_end = window.m_start + std::chrono::seconds(options.m_seconds);
+
+    if (!options.m_json)
+    {
+        std::cout << BOOST_CURRENT_FUNCTION << ' ' << options.m_connections
+                  << " connections to 127.0.0.1:" << port << ", "
+                  << options.m_message_size << " bytes per message, ";
+        if (options.m_rate > 0.0)
+            std::cout << "open loop at " << options.m_rate << " msgs/s per connection, ";
+        else
+            std::cout << "closed loop, ";
+        std::cout << options.m_seconds << " s after " << options.m_warmup.count()
+                  << " s of warmup, " << pool.GetSize() << " threads\n";
+    }
+
+    std::vector<std::shared_ptr<LoadConnection> > connections;
+    connections.reserve(options.m_connections);
+    for (size_t i = 0; i != options.m_connections; ++i)
+    {
+        size_t index = i % pool.GetSize();
+        auto connection = std::make_shared<LoadConnection>(
+            pool.GetHive(index), options, window, stats[index], running
+        );
+        connection->Connect("127.0.0.1", port);
+        connections.emplace_back(std::move(connection));
+    }
+
+    pool.Run();
+    std::this_thread::sleep_until(window.m_end);
+    running = false;
+
+    for (auto &&connection : connections)
+        connection->Disconnect();
+    pool.Stop();
+
+    for (auto &&acceptor : acceptors)
+        acceptor->Stop();
+    if (server_pool)
+        server_pool->Stop();
+
+    Stats total;
+    for (auto &&hive_stats : stats)
+    {
+        total.m_latency.Add(hive_stats.m_latency);
+        total.m_messages += hive_stats.m_messages;
+        total.m_bytes += hive_stats.m_bytes;
+        total.m_errors += hive_stats.m_errors;
+        total.m_connected += hive_stats.m_connected;
+    }
+
+    std::chrono::duration<double> elapsed = window.m_end - window.m_start;
+    if (options.m_json)
+        PrintJson(options, total, elapsed);
+    else
+        PrintText(options, total, elapsed);
+
+    return 0;
+}
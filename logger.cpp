@@ -0,0 +1,228 @@
+/* logger.cpp */
+#include "logger.h"
+#include <iostream>
+#include <algorithm>
+
+// Struct Logger::ThreadRing definition. Owns the registration of the ring
+// of one thread and marks it closed when the thread exits, so that the
+// flusher releases it once it has been drained.
+struct Logger::ThreadRing
+{
+	~ThreadRing()
+	{
+		if (m_ring)
+			m_ring->m_closed.store(true, std::memory_order_release);
+		Logger::m_thread_ring = nullptr;
+	}
+
+	std::shared_ptr<Ring> m_ring;
+};
+
+thread_local Logger::ThreadRing Logger::m_thread_ring_owner;
+
+// Logger::Ring constructor
+Logger::Ring::Ring(std::thread::id thread_id) :
+    m_records(std::make_unique<Record[]>(ring_capacity)),
+    m_thread_id(thread_id)
+{
+}
+
+// Logger::Instance definition
+Logger &Logger::Instance()
+{
+	static Logger logger(std::cout);
+	return logger;
+}
+
+// Logger constructor
+Logger::Logger(std::ostream &stream) :
+    m_stream(stream)
+{
+	m_thread = std::thread(&Logger::FlushThread, this);
+}
+
+// Logger destructor
+Logger::~Logger()
+{
+	{
+		std::lock_guard lck(m_stop_mutex);
+		m_stopped = true;
+	}
+	m_stop_cv.notify_one();
+	m_thread.join();
+}
+
+// Logger::RegisterThread definition
+Logger::Ring &Logger::RegisterThread()
+{
+	auto ring = std::make_shared<Ring>(std::this_thread::get_id());
+	{
+		std::lock_guard lck(m_rings_mutex);
+		m_rings.push_back(ring);
+	}
+	m_thread_ring_owner.m_ring = ring;
+	m_thread_ring = ring.get();
+	return *ring;
+}
+
+// Logger::Flush definition
+void Logger::Flush()
+{
+	Drain();
+}
+
+// Logger::SetFlushInterval definition
+void Logger::SetFlushInterval(std::chrono::milliseconds flush_interval)
+{
+	std::lock_guard lck(m_stop_mutex);
+	m_flush_interval = flush_interval;
+}
+
+// Logger::GetDroppedCount definition
+uint64_t Logger::GetDroppedCount() const
+{
+	return m_dropped.load(std::memory_order_relaxed);
+}
+
+// Logger::FlushThread definition
+void Logger::FlushThread()
+{
+	std::unique_lock lck(m_stop_mutex);
+	while (!m_stopped)
+	{
+		lck.unlock();
+		Drain();
+		lck.lock();
+		m_stop_cv.wait_for(lck, m_flush_interval, [this]() { return m_stopped; });
+	}
+	lck.unlock();
+	Drain();
+}
+
+// Logger::Drain definition
+void Logger::Drain()
+{
+	// The drain mutex keeps every ring single consumer when Flush runs
+	// next to the background thread
+	std::lock_guard drain_lck(m_drain_mutex);
+	{
+		std::lock_guard lck(m_rings_mutex);
+		m_drain_rings.assign(m_rings.begin(), m_rings.end());
+	}
+
+	for (auto &&ring : m_drain_rings)
+		DrainRing(*ring);
+	m_stream.flush();
+
+	// Release the rings of exited threads once they are empty
+	bool closed = std::any_of(
+        m_drain_rings.begin(),
+        m_drain_rings.end(),
+        [](auto &&ring)
+        {
+            return ring->m_closed.load(std::memory_order_acquire);
+        }
+    );
+	m_drain_rings.clear();
+	if (closed)
+	{
+		std::lock_guard lck(m_rings_mutex);
+		m_rings.erase(
+            std::remove_if(
+                m_rings.begin(),
+                m_rings.end(),
+                [](auto &&ring)
+                {
+                    return ring->m_closed.load(std::memory_order_acquire) &&
+                        ring->m_head.load(std::memory_order_acquire) ==
+                        ring->m_tail.load(std::memory_order_relaxed);
+                }
+            ),
+            m_rings.end()
+        );
+	}
+}
+
+// Logger::DrainRing definition
+void Logger::DrainRing(Ring &ring)
+{
+	uint64_t tail = ring.m_tail.load(std::memory_order_relaxed);
+	uint64_t head = ring.m_head.load(std::memory_order_acquire);
+	for (; tail != head; ++tail)
+	{
+		const Record &record = ring.m_records[tail & (ring_capacity - 1)];
+		m_stream << "Thread#" << ring.m_thread_id << ' ';
+		size_t offset = 0;
+		while (offset < record.m_length)
+		{
+			decode_type decode;
+			offset = Align(offset, alignof(decode_type));
+			std::memcpy(&decode, record.m_data + offset, sizeof(decode));
+			offset = decode(m_stream, record.m_data, offset + sizeof(decode));
+		}
+		m_stream << '\n';
+		ring.m_tail.store(tail + 1, std::memory_order_release);
+	}
+
+	uint64_t dropped = ring.m_dropped.exchange(0, std::memory_order_relaxed);
+	if (dropped)
+	{
+		m_dropped.fetch_add(dropped, std::memory_order_relaxed);
+		m_stream << "Thread#" << ring.m_thread_id << " Logger dropped "
+                 << dropped << " records\n";
+	}
+}
+
+// Logger::PutBytes definition
+size_t Logger::PutBytes(uint8_t *data, size_t offset, size_t reserve, const void *bytes, size_t size)
+{
+	offset += sizeof(uint32_t);
+	auto length = static_cast<uint32_t>(std::min(size, payload_size - offset - reserve));
+	std::memcpy(data + offset - sizeof(uint32_t), &length, sizeof(length));
+	std::memcpy(data + offset, bytes, length);
+	return offset + length;
+}
+
+// Logger::DecodeString definition
+size_t Logger::DecodeString(std::ostream &stream, const uint8_t *data, size_t offset)
+{
+	uint32_t length;
+	std::memcpy(&length, data + offset, sizeof(length));
+	offset += sizeof(length);
+	stream.write(reinterpret_cast<const char *>(data + offset), length);
+	return offset + length;
+}
+
+// Logger::DecodeHex definition
+size_t Logger::DecodeHex(std::ostream &stream, const uint8_t *data, size_t offset)
+{
+	constexpr char digits[] = "0123456789abcdef";
+
+	uint64_t size;
+	uint32_t length;
+	std::memcpy(&size, data + offset, sizeof(size));
+	offset += sizeof(size);
+	std::memcpy(&length, data + offset, sizeof(length));
+	offset += sizeof(length);
+
+	for (uint32_t x = 0; x < length; ++x)
+	{
+		if (x && x % 16 == 0)
+			stream << '\n';
+
+		uint8_t byte = data[offset + x];
+		if (isprint(byte) && !iscntrl(byte))
+		{
+			stream << static_cast<char>(byte) << ' ';
+		}
+		else
+		{
+			char hex[] = {'0', 'x', digits[byte >> 4], digits[byte & 0xf], ' '};
+			stream.write(hex, sizeof(hex));
+		}
+	}
+
+	if (length < size)
+		stream << "... " << size - length << " more bytes";
+	return offset + length;
+}
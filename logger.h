@@ -0,0 +1,258 @@
+/* logger.h */
+#ifndef _LOGGER_H_
+#define _LOGGER_H_
+
+// Include the required header files
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <ostream>
+#include <type_traits>
+#include <cctype>
+
+// Struct LogHex definition. Passed to Logger::Write to dump a byte buffer:
+// printable bytes are written as characters, the others as hex values, 16
+// per line. Only as many bytes as fit in the record are captured.
+struct LogHex
+{
+	LogHex(const uint8_t *data, size_t size) :
+        m_data(data),
+        m_size(size)
+	{
+	}
+
+	template<class Container>
+	explicit LogHex(const Container &buffer) :
+        LogHex(buffer.data(), buffer.size())
+	{
+	}
+
+	const uint8_t *m_data;
+	size_t m_size;
+};
+
+// Class Logger definition and its members declaration. Every thread that
+// writes gets its own single producer ring of fixed size records, so the
+// writer never takes a lock and never formats: the arguments are copied
+// into the record and a background thread turns them into text later.
+// When a ring is full the record is dropped and counted instead of
+// blocking the writer. Lines of one thread keep their order; lines of
+// different threads may interleave differently than they were written.
+class Logger
+{
+public:
+	// Size in bytes of one record, arguments included.
+	static constexpr size_t record_size = 512;
+	// Number of records a thread can have waiting for the flusher.
+	static constexpr size_t ring_capacity = 1024;
+
+	// Returns the process wide logger writing to std::cout. It is created
+	// on first use and flushes everything left when the program exits, so
+	// threads that log must be joined before main returns.
+	static Logger &Instance();
+
+	Logger(const Logger & rhs) = delete;
+	Logger & operator =(const Logger & rhs) = delete;
+
+	// Queues one line made of the arguments, prefixed with the id of the
+	// calling thread. Strings are copied and truncated to fit the record,
+	// other arguments are copied as they are and must be printable with
+	// operator<< and trivially destructible, so that copying them needs no
+	// allocation.
+	template<class... Args>
+	void Write(const Args &... args);
+
+	// Writes every record queued before the call and flushes the stream.
+	void Flush();
+
+	// Sets how often the background thread drains the rings. The default
+	// value is 1 ms.
+	void SetFlushInterval(std::chrono::milliseconds flush_interval);
+
+	// Returns the number of records dropped because a ring was full.
+	uint64_t GetDroppedCount() const;
+
+	~Logger();
+
+private:
+	using decode_type = size_t (*)(std::ostream &, const uint8_t *, size_t);
+
+	static constexpr size_t payload_size = record_size - alignof(std::max_align_t);
+
+	struct Record
+	{
+		uint32_t m_length;
+		alignas(std::max_align_t) uint8_t m_data[payload_size];
+	};
+
+	struct Ring
+	{
+		explicit Ring(std::thread::id thread_id);
+
+		std::unique_ptr<Record[]> m_records;
+		std::thread::id m_thread_id;
+		alignas(64) std::atomic<uint64_t> m_head{0};
+		alignas(64) std::atomic<uint64_t> m_tail{0};
+		std::atomic<uint64_t> m_dropped{0};
+		std::atomic<bool> m_closed{false};
+	};
+
+	struct ThreadRing;
+
+	explicit Logger(std::ostream &stream);
+
+	Ring &GetRing();
+	Ring &RegisterThread();
+	void Drain();
+	void DrainRing(Ring &ring);
+	void FlushThread();
+
+	template<class T>
+	static constexpr bool is_string_v = std::is_convertible_v<const T &, std::string_view>;
+
+	static constexpr size_t Align(size_t offset, size_t alignment)
+	{
+		return (offset + alignment - 1) & ~(alignment - 1);
+	}
+
+	// Upper bound of the bytes an argument of type T takes in a record.
+	template<class T>
+	static constexpr size_t MinSize()
+	{
+		constexpr size_t header = sizeof(decode_type) + alignof(decode_type) - 1;
+		if constexpr (is_string_v<T>)
+			return header + sizeof(uint32_t);
+		else if constexpr (std::is_same_v<T, LogHex>)
+			return header + sizeof(uint64_t) + sizeof(uint32_t);
+		else
+			return header + sizeof(T) + alignof(T) - 1;
+	}
+
+	static size_t PutDecoder(uint8_t *data, size_t offset, decode_type decode)
+	{
+		offset = Align(offset, alignof(decode_type));
+		std::memcpy(data + offset, &decode, sizeof(decode));
+		return offset + sizeof(decode);
+	}
+
+	static size_t PutBytes(uint8_t *data, size_t offset, size_t reserve, const void *bytes, size_t size);
+
+	template<class T>
+	static size_t Encode(uint8_t *data, size_t offset, size_t reserve, const T &value)
+	{
+		if constexpr (is_string_v<T>)
+		{
+			std::string_view str(value);
+			offset = PutDecoder(data, offset, &DecodeString);
+			return PutBytes(data, offset, reserve, str.data(), str.size());
+		}
+		else if constexpr (std::is_same_v<T, LogHex>)
+		{
+			uint64_t size = value.m_size;
+			offset = PutDecoder(data, offset, &DecodeHex);
+			std::memcpy(data + offset, &size, sizeof(size));
+			return PutBytes(data, offset + sizeof(size), reserve, value.m_data, value.m_size);
+		}
+		else
+		{
+			static_assert(
+                std::is_trivially_destructible_v<T>,
+                "Logger::Write copies arguments without running destructors"
+            );
+			offset = PutDecoder(data, offset, &DecodeValue<T>);
+			offset = Align(offset, alignof(T));
+			::new (static_cast<void *>(data + offset)) T(value);
+			return offset + sizeof(T);
+		}
+	}
+
+	template<class T, class... Rest>
+	static size_t EncodeAll(uint8_t *data, size_t offset, const T &value, const Rest &... rest)
+	{
+		// Leave room for the arguments behind a string that gets truncated
+		offset = Encode(data, offset, (MinSize<Rest>() + ... + 0), value);
+		if constexpr (sizeof...(Rest) > 0)
+			return EncodeAll(data, offset, rest...);
+		else
+			return offset;
+	}
+
+	template<class T>
+	static size_t DecodeValue(std::ostream &stream, const uint8_t *data, size_t offset)
+	{
+		offset = Align(offset, alignof(T));
+		stream << *std::launder(reinterpret_cast<const T *>(data + offset));
+		return offset + sizeof(T);
+	}
+
+	static size_t DecodeString(std::ostream &stream, const uint8_t *data, size_t offset);
+	static size_t DecodeHex(std::ostream &stream, const uint8_t *data, size_t offset);
+
+private:
+	static inline thread_local Ring *m_thread_ring{nullptr};
+	static thread_local ThreadRing m_thread_ring_owner;
+
+	std::ostream &m_stream;
+	std::mutex m_rings_mutex;
+	std::vector<std::shared_ptr<Ring> > m_rings;
+	std::mutex m_drain_mutex;
+	std::vector<std::shared_ptr<Ring> > m_drain_rings;
+	std::mutex m_stop_mutex;
+	std::condition_variable m_stop_cv;
+	std::chrono::milliseconds m_flush_interval{1};
+	bool m_stopped{false};
+	std::atomic<uint64_t> m_dropped{0};
+	std::thread m_thread;
+};
+
+// Logger::GetRing definition
+inline Logger::Ring &Logger::GetRing()
+{
+	if (m_thread_ring)
+		return *m_thread_ring;
+	return RegisterThread();
+}
+
+// Logger::Write definition
+template<class... Args>
+void Logger::Write(const Args &... args)
+{
+	static_assert(
+        (MinSize<Args>() + ... + 0) <= payload_size,
+        "Logger::Write arguments do not fit in a record"
+    );
+
+	Ring &ring = GetRing();
+	uint64_t head = ring.m_head.load(std::memory_order_relaxed);
+	if (head - ring.m_tail.load(std::memory_order_acquire) == ring_capacity)
+	{
+		ring.m_dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	Record &record = ring.m_records[head & (ring_capacity - 1)];
+	size_t length = 0;
+	if constexpr (sizeof...(Args) > 0)
+		length = EncodeAll(record.m_data, 0, args...);
+	record.m_length = static_cast<uint32_t>(length);
+	ring.m_head.store(head + 1, std::memory_order_release);
+}
+
+// Queues one line on the process wide logger.
+template<class... Args>
+void Log(const Args &... args)
+{
+	Logger::Instance().Write(args...);
+}
+
+#endif
@@ -0,0 +1,185 @@
+/* policybench.cpp */
+#include "wrapper.h"
+#include <boost/current_function.hpp>
+#include <iostream>
+#include <chrono>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <string>
+#include <cstdlib>
+#include <cstdio>
+
+// Compares the threading policies of BasicConnection on a Hive run by a
+// single thread, as in a thread-per-core server. Pairs of connections
+// bounce a message over loopback; every round trip completes two sends and
+// two receives in continuous receive mode. With MultiThreaded each Send
+// posts to the strand of the connection and every handler goes through
+// it, with SingleThreaded Send queues the data right away and the handlers
+// run on the io_context directly.
+//
+// usage: policybench [pairs] [seconds] [message bytes]
+
+template<class Policy>
+class PingConnection : public BasicConnection<Policy>
+{
+public:
+    PingConnection(std::shared_ptr<Hive> hive, size_t message_size, std::atomic<uint64_t> *round_trips) :
+        BasicConnection<Policy>(hive),
+        m_message_size(message_size),
+        m_round_trips(round_trips)
+    {
+        this->SetContinuousRecv(true);
+    }
+
+    ~PingConnection() override = default;
+
+private:
+    void OnAccept(const std::string &host, uint16_t port) override
+    {
+        this->Recv();
+    }
+
+    void OnConnect(const std::string &host, uint16_t port) override
+    {
+        this->Recv();
+        auto buffer = this->GetHive()->GetBufferPool().Acquire(m_message_size);
+        buffer.resize(m_message_size, 'x');
+        this->Send(std::move(buffer));
+    }
+
+    void OnSend(const std::vector<uint8_t> &buffer) override
+    {
+    }
+
+    void OnRecv(std::vector<uint8_t> &buffer) override
+    {
+        if (m_round_trips)
+            m_round_trips->fetch_add(1, std::memory_order_relaxed);
+
+        // Bounce the bytes back, the buffer pool replaces the receive buffer
+        this->Send(std::move(buffer));
+    }
+
+    void OnTimer(const boost::posix_time::time_duration &delta) override
+    {
+    }
+
+    void OnError(const boost::system::error_code &error) override
+    {
+    }
+
+private:
+    size_t m_message_size;
+    std::atomic<uint64_t> *m_round_trips;
+};
+
+template<class Policy>
+class PingAcceptor : public BasicAcceptor<Policy>
+{
+public:
+    PingAcceptor(std::shared_ptr<Hive> hive, size_t message_size) :
+        BasicAcceptor<Policy>(hive),
+        m_message_size(message_size)
+    {}
+
+    ~PingAcceptor() override = default;
+
+    std::vector<std::shared_ptr<BasicConnection<Policy> > > m_accepted;
+
+private:
+    std::shared_ptr<BasicConnection<Policy> > CreateConnection() override
+    {
+        return std::make_shared<PingConnection<Policy> >(this->GetHive(), m_message_size, nullptr);
+    }
+
+    bool OnAccept(
+        std::shared_ptr<BasicConnection<Policy> > connection,
+        const std::string &host,
+        uint16_t port
+    ) override
+    {
+        m_accepted.emplace_back(std::move(connection));
+        return true;
+    }
+
+    void OnTimer(const boost::posix_time::time_duration &delta) override
+    {
+    }
+
+    void OnError(const boost::system::error_code &error) override
+    {
+    }
+
+private:
+    size_t m_message_size;
+};
+
+template<class Policy>
+uint64_t Bench(size_t pairs, size_t seconds, size_t message_size)
+{
+    auto hive = std::make_shared<Hive>(1);
+    auto acceptor = std::make_shared<PingAcceptor<Policy> >(hive, message_size);
+    acceptor->SetPendingAccepts(16);
+    acceptor->Listen("127.0.0.1", 0);
+    acceptor->Accept();
+    uint16_t port = acceptor->GetAcceptor().local_endpoint().port();
+
+    // With SingleThreaded the objects may only be used from the thread
+    // running the Hive, so the clients are connected before it starts
+    std::atomic<uint64_t> round_trips{0};
+    std::vector<std::shared_ptr<PingConnection<Policy> > > clients;
+    for (size_t i = 0; i != pairs; ++i)
+    {
+        auto client = std::make_shared<PingConnection<Policy> >(hive, message_size, &round_trips);
+        client->Connect("127.0.0.1", port);
+        clients.emplace_back(std::move(client));
+    }
+    std::thread runner([hive]() { hive->Run(); });
+
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+    uint64_t first_round_trip = round_trips.load();
+    std::this_thread::sleep_for(std::chrono::seconds(seconds));
+    uint64_t result = round_trips.load() - first_round_trip;
+
+    // Stopped from the thread running the Hive too, which then returns
+    // from Run once the connections have closed
+    boost::asio::post(
+        hive->GetContext(),
+        [hive, acceptor, &clients]()
+        {
+            for (auto &&client : clients)
+                client->Disconnect();
+            acceptor->Stop();
+            hive->Stop();
+        }
+    );
+    runner.join();
+    return result;
+}
+
+int main(int argc, char *argv[])
+{
+    size_t pairs = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 16;
+    size_t seconds = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 3;
+    size_t message_size = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 64;
+
+    std::cout << BOOST_CURRENT_FUNCTION << ' ' << pairs << " pairs, " << seconds << " s, "
+              << message_size << " byte messages, one thread\n\n";
+
+    auto report = [seconds](const char *name, uint64_t round_trips)
+    {
+        char line[160];
+        std::snprintf(
+            line, sizeof(line), "%-16s %12llu round trips %12.0f per second\n",
+            name, static_cast<unsigned long long>(round_trips),
+            static_cast<double>(round_trips) / seconds
+        );
+        std::cout << line << std::flush;
+    };
+
+    report("MultiThreaded", Bench<MultiThreaded>(pairs, seconds, message_size));
+    report("SingleThreaded", Bench<SingleThreaded>(pairs, seconds, message_size));
+
+    return 0;
+}
@@ -1,9 +1,9 @@
 /* readwritesocket.cpp */
 #include <boost/asio.hpp>
 #include <boost/current_function.hpp>
+#include "logger.h"
 #include <memory>
 #include <thread>
-#include <mutex>
 #include <cstdint>
 #include <iostream>
 #include <string>
@@ -12,16 +12,9 @@
 #include <algorithm>
 #include <type_traits>
 
-std::mutex global_stream_lock;
-
 void WorkerThread(boost::asio::io_context &ioctx, size_t counter)
 {
-    {
-        std::lock_guard lck(global_stream_lock);
-        std::cout << "Thread#" << std::this_thread::get_id() << ' '
-                  << BOOST_CURRENT_FUNCTION << ' '
-                  << counter << " Start.\n";
-    }
+    Log(BOOST_CURRENT_FUNCTION, ' ', counter, " Start.");
 
     while (true)
     {
@@ -31,26 +24,17 @@ void WorkerThread(boost::asio::io_context &ioctx, size_t counter)
             ioctx.run(ec);
             if (ec)
             {
-                std::lock_guard lck(global_stream_lock);
-                std::cout << "Thread#" << std::this_thread::get_id() << ' '
-                          << BOOST_CURRENT_FUNCTION
-                          << " Error message: " << ec << ".\n";
+                Log(BOOST_CURRENT_FUNCTION, " Error message: ", ec, '.');
             }
             break;
         }
         catch (std::exception &e)
         {
-            std::lock_guard lck(global_stream_lock);
-            std::cout << "Thread#" << std::this_thread::get_id() << ' '
-                      << BOOST_CURRENT_FUNCTION
-                      << " Exception message: " << e.what() << ".\n";
+            Log(BOOST_CURRENT_FUNCTION, " Exception message: ", e.what(), '.');
         }
     }
 
-    std::lock_guard lck(global_stream_lock);
-    std::cout << "Thread#" << std::this_thread::get_id() << ' '
-              << BOOST_CURRENT_FUNCTION << ' '
-              << counter << " End.\n";
+    Log(BOOST_CURRENT_FUNCTION, ' ', counter, " End.");
 }
 
 struct ClientContext final : public std::enable_shared_from_this<ClientContext>
@@ -77,20 +61,18 @@ struct ClientContext final : public std::enable_shared_from_this<ClientContext>
     {
         if (ec)
         {
-            std::lock_guard lck(global_stream_lock);
-            std::cout << "Thread#" << std::this_thread::get_id() << ' '
-                      << BOOST_CURRENT_FUNCTION
-                      << " Error message: " << ec << " cannot send data to "
-                      << m_socket.remote_endpoint() << ".\n";
+            Log(
+                BOOST_CURRENT_FUNCTION, " Error message: ", ec,
+                " cannot send data to ", m_socket.remote_endpoint(), '.'
+            );
             Close();
         }
         else
         {
-            std::lock_guard lck(global_stream_lock);
-            std::cout << "Thread#" << std::this_thread::get_id() << ' '
-                      << BOOST_CURRENT_FUNCTION
-                      << " Sent " << it->size() << " bytes to "
-                      << m_socket.remote_endpoint() << ".\n";
+            Log(
+                BOOST_CURRENT_FUNCTION, " Sent ", it->size(), " bytes to ",
+                m_socket.remote_endpoint(), '.'
+            );
         }
         m_send_buffer.erase(it);
 
@@ -129,11 +111,10 @@ struct ClientContext final : public std::enable_shared_from_this<ClientContext>
     {
         if (ec)
         {
-            std::lock_guard lck(global_stream_lock);
-            std::cout << "Thread#" << std::this_thread::get_id() << ' '
-                      << BOOST_CURRENT_FUNCTION
-                      << " Error message: " << ec << " cannot receive data from "
-                      << m_socket.remote_endpoint() << ".\n";
+            Log(
+                BOOST_CURRENT_FUNCTION, " Error message: ", ec,
+                " cannot receive data from ", m_socket.remote_endpoint(), '.'
+            );
             Close();
             return;
         }
@@ -141,25 +122,11 @@ struct ClientContext final : public std::enable_shared_from_this<ClientContext>
         {
             // Debug information
             boost::asio::ip::tcp::endpoint remote_ep = m_socket.remote_endpoint();
-            std::lock_guard lck(global_stream_lock);
-            std::cout << "Thread#" << std::this_thread::get_id() << ' '
-                      << BOOST_CURRENT_FUNCTION << ' '
-                      << bytes_transferred << " bytes from " << remote_ep << ".\n";
-
             m_recv_buffer_index += bytes_transferred;
-
-            for (size_t x = 0; x < m_recv_buffer_index; ++x)
-            {
-                if (isprint(m_recv_buffer[x]) && !iscntrl(m_recv_buffer[x]))
-                    std::cout  << m_recv_buffer[x] << ' ';
-                else
-                    std::cout << std::hex << "0x" << (int)m_recv_buffer[x] << ' ';
-
-                if (x && (x) % 16 == 0)
-                    std::cout << '\n';
-            }
-
-            std::cout << std::endl;
+            Log(
+                BOOST_CURRENT_FUNCTION, ' ', bytes_transferred, " bytes from ",
+                remote_ep, ". ", LogHex(m_recv_buffer.data(), m_recv_buffer_index)
+            );
 
             // Clear all the data
             m_recv_buffer_index = 0;
@@ -202,19 +169,14 @@ void OnAccept(
     std::shared_ptr<ClientContext> clnt
 )
 {
-    std::lock_guard lck(global_stream_lock);
     if (ec)
     {
-        std::cout << "Thread#" << std::this_thread::get_id() << ' '
-                  << BOOST_CURRENT_FUNCTION
-                  << " Error message: " << ec << ".\n";
+        Log(BOOST_CURRENT_FUNCTION, " Error message: ", ec, '.');
     }
     else
     {
         auto remote_ep = clnt->m_socket.remote_endpoint();
-        std::cout << "Thread#" << std::this_thread::get_id() << ' '
-                  << BOOST_CURRENT_FUNCTION
-                  << " Accepted connection from " << remote_ep << "!\n";
+        Log(BOOST_CURRENT_FUNCTION, " Accepted connection from ", remote_ep, '!');
         auto new_client = std::make_shared<ClientContext>(ac.get_executor());
         auto &&sckt = new_client->m_socket;
         ac.async_accept(
@@ -237,12 +199,7 @@ int main()
     boost::asio::io_context io_ctx;
     auto worker = boost::asio::make_work_guard(io_ctx);
 
-    {
-        std::lock_guard lck(global_stream_lock);
-        std::cout << "Thread#" << std::this_thread::get_id() << ' '
-                  << BOOST_CURRENT_FUNCTION
-                  << " Press ENTER to exit!\n";
-    }
+    Log(BOOST_CURRENT_FUNCTION, " Press ENTER to exit!");
 
     auto threads_count = std::thread::hardware_concurrency();
     std::vector<std::thread> threads(threads_count);
@@ -280,19 +237,11 @@ int main()
                 OnAccept(std::ref(ac), ec, cl);
             }
         );
-        {
-            std::lock_guard lck(global_stream_lock);
-            std::cout << "Thread#" << std::this_thread::get_id() << ' '
-                      << BOOST_CURRENT_FUNCTION
-                      << " Listening on: " << endpoint << ".\n";
-        }
+        Log(BOOST_CURRENT_FUNCTION, " Listening on: ", endpoint, '.');
     }
     catch (std::exception &e)
     {
-        std::lock_guard lck(global_stream_lock);
-        std::cout << "Thread#" << std::this_thread::get_id() << ' '
-                  << BOOST_CURRENT_FUNCTION
-                  << " Exception message: " << e.what() << ".\n";
+        Log(BOOST_CURRENT_FUNCTION, " Exception message: ", e.what(), '.');
     }
 
     std::cin.get();
@@ -0,0 +1,147 @@
+/* strandbench.cpp */
+#include <utility> // ahead of boost/asio.hpp, as in wrapper.h
+#include <boost/asio.hpp>
+#include <boost/current_function.hpp>
+#include <thread>
+#include <iostream>
+#include <chrono>
+#include <vector>
+#include <memory>
+#include <cstdlib>
+
+// Measures handler throughput of many independent strands, one per
+// simulated connection. Each connection keeps several handlers in flight
+// on its strand, as a Connection does with its receive, send, timer and
+// posted work. With blocking work every handler sleeps, like a handler 
+// that waits on a lock or a synchronous call, instead of spinning. This is
+// where io_context::strand loses: it hashes the connections into a fixed 
+// set of implementations, so two unrelated connections that collide wait
+// for each other while threads are left idle.
+//
+// usage: strandbench [connections] [handlers per connection] [threads] 
+//                    [work ns] [handlers in flight] [blocking work 0/1]
+
+using Clock = std::chrono::steady_clock;
+
+void SpinFor(std::chrono::nanoseconds ns)
+{
+    auto until = Clock::now() + ns;
+    while (Clock::now() < until)
+        ;
+}
+
+struct Options
+{
+    size_t m_connections{256};
+    size_t m_handlers{200};
+    size_t m_threads{256};
+    std::chrono::nanoseconds m_work{1000000};
+    size_t m_in_flight{4};
+    bool m_blocking{true};
+};
+
+template<class Strand>
+struct FakeConnection
+{
+    Strand m_strand;
+    const Options &m_options;
+    // Handlers not posted yet, only changed on the strand once running
+    size_t m_unposted;
+
+    FakeConnection(Strand strand, const Options &options) :
+        m_strand(std::move(strand)),
+        m_options(options),
+        m_unposted(options.m_handlers)
+    {}
+
+    void Start()
+    {
+        for (size_t i = 0; i != m_options.m_in_flight && m_unposted; ++i)
+            Post();
+    }
+
+    void Post()
+    {
+        --m_unposted;
+        boost::asio::post(
+            m_strand,
+            [this]()
+            {
+                if (m_options.m_blocking)
+                    std::this_thread::sleep_for(m_options.m_work);
+                else
+                    SpinFor(m_options.m_work);
+                if (m_unposted)
+                    Post();
+            }
+        );
+    }
+};
+
+template<class MakeStrand>
+double RunBench(const char *name, MakeStrand make_strand, const Options &options)
+{
+    boost::asio::io_context io_ctx(static_cast<int>(options.m_threads));
+    using strand_t = decltype(make_strand(io_ctx));
+    std::vector<std::unique_ptr<FakeConnection<strand_t> > > conns;
+    conns.reserve(options.m_connections);
+    for (size_t i = 0; i != options.m_connections; ++i)
+        conns.emplace_back(std::make_unique<FakeConnection<strand_t> >(make_strand(io_ctx), options));
+
+    for (auto &&conn : conns)
+        conn->Start();
+
+    auto start = Clock::now();
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i != options.m_threads; ++i)
+        threads.emplace_back([&io_ctx]() { io_ctx.run(); });
+    for (auto &&th : threads)
+        th.join();
+    std::chrono::duration<double> elapsed = Clock::now() - start;
+
+    double total = static_cast<double>(options.m_connections) * options.m_handlers;
+    double rate = total / elapsed.count();
+    std::cout << name << ": " << static_cast<uint64_t>(total) << " handlers in "
+              << elapsed.count() << " s, " << static_cast<uint64_t>(rate)
+              << " handlers/s\n";
+    return rate;
+}
+
+int main(int argc, char *argv[])
+{
+    Options options;
+    if (argc > 1)
+        options.m_connections = std::strtoull(argv[1], nullptr, 10);
+    if (argc > 2)
+        options.m_handlers = std::strtoull(argv[2], nullptr, 10);
+    if (argc > 3)
+        options.m_threads = std::strtoull(argv[3], nullptr, 10);
+    if (argc > 4)
+        options.m_work = std::chrono::nanoseconds(std::strtoull(argv[4], nullptr, 10));
+    if (argc > 5)
+        options.m_in_flight = std::strtoull(argv[5], nullptr, 10);
+    if (argc > 6)
+        options.m_blocking = 0 != std::strtoull(argv[6], nullptr, 10);
+    if (0 == options.m_threads)
+        options.m_threads = 1;
+
+    std::cout << BOOST_CURRENT_FUNCTION << ' ' << options.m_connections << " connections, "
+              << options.m_handlers << " handlers each, " << options.m_in_flight << " in flight, "
+              << options.m_threads << " threads, " << options.m_work.count() << " ns of "
+              << (options.m_blocking ? "blocking" : "spinning") << " work per handler\n";
+
+    double legacy = RunBench(
+        "io_context::strand",
+        [](boost::asio::io_context &io) { return boost::asio::io_context::strand(io); },
+        options
+    );
+    double modern = RunBench(
+        "strand<io_context::executor_type>",
+        [](boost::asio::io_context &io) { return boost::asio::make_strand(io); },
+        options
+    );
+
+    std::cout << "speedup: " << modern / legacy << "x\n";
+
+    return 0;
+}
@@ -0,0 +1,232 @@
+/* streambench.cpp */
+#include "wrapper.h"
+#include <boost/current_function.hpp>
+#include <iostream>
+#include <chrono>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <string>
+#include <future>
+#include <cstdlib>
+#include <cstdio>
+
+// Measures the receive throughput of a Connection that reads a one-way
+// stream over loopback, either by calling Recv from every OnRecv or in
+// continuous mode, where the next read is started without a post. The
+// paused rows call PauseRecv every time the reader has received another
+// window of bytes and ResumeRecv from a posted handler, in the way a
+// downstream queue applies backpressure.
+//
+// The stream is written by a blocking client thread in large chunks.
+//
+// usage: streambench [megabytes] [receive buffer bytes]
+
+using Clock = std::chrono::steady_clock;
+
+constexpr size_t write_chunk = 256 * 1024;
+constexpr uint64_t pause_window = 1024 * 1024;
+
+enum class Mode { recv_per_chunk, continuous, continuous_paused };
+
+// Connects to port and writes total_bytes.
+void WriteStream(uint16_t port, uint64_t total_bytes)
+{
+    boost::asio::io_context io_ctx;
+    boost::asio::ip::tcp::socket socket(io_ctx);
+    socket.connect(
+        boost::asio::ip::tcp::endpoint(boost::asio::ip::address_v4::loopback(), port)
+    );
+    std::vector<uint8_t> chunk(write_chunk, 'x');
+    for (uint64_t written = 0; written < total_bytes; written += chunk.size())
+    {
+        size_t size = static_cast<size_t>(std::min<uint64_t>(chunk.size(), total_bytes - written));
+        boost::asio::write(socket, boost::asio::buffer(chunk.data(), size));
+    }
+    boost::system::error_code ec;
+    socket.shutdown(boost::asio::ip::tcp::socket::shutdown_send, ec);
+}
+
+class StreamConnection : public Connection
+{
+public:
+    StreamConnection(std::shared_ptr<Hive> hive) :
+        Connection(hive)
+    {
+    }
+
+    ~StreamConnection() override = default;
+
+    void SetTarget(Mode mode, uint64_t total_bytes, std::promise<uint64_t> *done)
+    {
+        m_mode = mode;
+        m_total_bytes = total_bytes;
+        m_done = done;
+        SetContinuousRecv(Mode::recv_per_chunk != mode);
+    }
+
+private:
+    void OnAccept(const std::string &host, uint16_t port) override
+    {
+        Recv();
+    }
+
+    void OnConnect(const std::string &host, uint16_t port) override
+    {
+    }
+
+    void OnSend(const std::vector<uint8_t> &buffer) override
+    {
+    }
+
+    void OnRecv(std::vector<uint8_t> &buffer) override
+    {
+        m_received += buffer.size();
+        ++m_reads;
+        if (m_received >= m_total_bytes)
+        {
+            m_done->set_value(m_reads);
+            return;
+        }
+
+        if (Mode::recv_per_chunk == m_mode)
+        {
+            Recv();
+        }
+        else if (Mode::continuous_paused == m_mode && m_received >= m_next_pause)
+        {
+            m_next_pause += pause_window;
+            PauseRecv();
+            boost::asio::post(
+                GetHive()->GetContext(),
+                [self=shared_from_this()]()
+                {
+                    std::static_pointer_cast<StreamConnection>(self)->ResumeRecv();
+                }
+            );
+        }
+    }
+
+    void OnTimer(const boost::posix_time::time_duration &delta) override
+    {
+    }
+
+    void OnError(const boost::system::error_code &error) override
+    {
+    }
+
+private:
+    Mode m_mode{Mode::recv_per_chunk};
+    uint64_t m_total_bytes{0};
+    uint64_t m_received{0};
+    uint64_t m_reads{0};
+    uint64_t m_next_pause{pause_window};
+    std::promise<uint64_t> *m_done{nullptr};
+};
+
+class StreamAcceptor : public Acceptor
+{
+public:
+    StreamAcceptor(
+        std::shared_ptr<Hive> hive,
+        Mode mode,
+        uint64_t total_bytes,
+        int32_t buffer_size,
+        std::promise<uint64_t> *done
+    ) :
+        Acceptor(hive),
+        m_mode(mode),
+        m_total_bytes(total_bytes),
+        m_buffer_size(buffer_size),
+        m_done(done)
+    {}
+
+    ~StreamAcceptor() override = default;
+
+private:
+    std::shared_ptr<Connection> CreateConnection() override
+    {
+        auto connection = std::make_shared<StreamConnection>(GetHive());
+        connection->SetReceiveBufferSize(m_buffer_size);
+        connection->SetTarget(m_mode, m_total_bytes, m_done);
+        return connection;
+    }
+
+    bool OnAccept(
+        std::shared_ptr<Connection> connection,
+        const std::string &host,
+        uint16_t port
+    ) override
+    {
+        return true;
+    }
+
+    void OnTimer(const boost::posix_time::time_duration &delta) override
+    {
+    }
+
+    void OnError(const boost::system::error_code &error) override
+    {
+    }
+
+private:
+    Mode m_mode;
+    uint64_t m_total_bytes;
+    int32_t m_buffer_size;
+    std::promise<uint64_t> *m_done;
+};
+
+struct Result
+{
+    double m_seconds;
+    uint64_t m_reads;
+};
+
+Result Bench(Mode mode, uint64_t total_bytes, int32_t buffer_size)
+{
+    std::promise<uint64_t> done;
+    auto future = done.get_future();
+    auto hive = std::make_shared<Hive>(1);
+    auto acceptor = std::make_shared<StreamAcceptor>(hive, mode, total_bytes, buffer_size, &done);
+    acceptor->Listen("127.0.0.1", 0);
+    acceptor->Accept();
+    std::thread runner([hive]() { hive->Run(); });
+
+    auto start = Clock::now();
+    std::thread writer(&WriteStream, acceptor->GetAcceptor().local_endpoint().port(), total_bytes);
+    uint64_t reads = future.get();
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    writer.join();
+    acceptor->Stop();
+    hive->Stop();
+    runner.join();
+    return Result{seconds, reads};
+}
+
+int main(int argc, char *argv[])
+{
+    uint64_t megabytes = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 2048;
+    int32_t buffer_size = argc > 2 ? static_cast<int32_t>(std::strtol(argv[2], nullptr, 10)) : 4096;
+    uint64_t total_bytes = megabytes * 1024 * 1024;
+
+    std::cout << BOOST_CURRENT_FUNCTION << ' ' << megabytes << " MB, "
+              << buffer_size << " byte receive buffer\n\n";
+
+    auto report = [total_bytes](const char *name, const Result &result)
+    {
+        char line[160];
+        std::snprintf(
+            line, sizeof(line), "%-24s %8.3f s %10.1f MB/s %12llu reads\n",
+            name, result.m_seconds, total_bytes / result.m_seconds / 1e6,
+            static_cast<unsigned long long>(result.m_reads)
+        );
+        std::cout << line << std::flush;
+    };
+
+    report("Recv per OnRecv", Bench(Mode::recv_per_chunk, total_bytes, buffer_size));
+    report("continuous", Bench(Mode::continuous, total_bytes, buffer_size));
+    report("continuous, paused", Bench(Mode::continuous_paused, total_bytes, buffer_size));
+
+    return 0;
+}
@@ -1,8 +1,525 @@
 /* wrapper.cpp */
 #include "wrapper.h"
+#include "logger.h"
 #include <boost/bind.hpp>
 #include <charconv>
 #include <system_error>
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace
+{
+	// Converts a steady_clock duration to the type used by OnTimer.
+	boost::posix_time::time_duration ToTimeDuration(CoarseClock::clock_type::duration duration)
+	{
+		return boost::posix_time::microseconds(
+            std::chrono::duration_cast<std::chrono::microseconds>(duration).count()
+        );
+	}
+
+	// Returns true for the outcome of a normal close or shutdown, which is 
+	// not logged.
+	bool IsOrderlyClose(const boost::system::error_code &error)
+	{
+		return !error ||
+            boost::asio::error::operation_aborted == error ||
+            boost::asio::error::eof == error ||
+            boost::asio::error::connection_reset == error;
+	}
+
+	// asio does not wrap SO_REUSEPORT
+#if defined(SO_REUSEPORT)
+	using reuse_port = boost::asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>;
+#endif
+
+	// Non-owning view over the gathered send buffers. Passing the vector
+	// itself to async_write would copy it into the operation state.
+	struct ConstBufferRange
+	{
+		using value_type = boost::asio::const_buffer;
+		using const_iterator = const boost::asio::const_buffer *;
+
+		const_iterator m_begin;
+		const_iterator m_end;
+
+		const_iterator begin() const { return m_begin; }
+		const_iterator end() const { return m_end; }
+	};
+}
+
+// BufferPool constructor
+BufferPool::BufferPool(size_t block_size, size_t max_blocks) :
+    m_block_size(block_size),
+    m_max_blocks(max_blocks)
+{
+	m_free_blocks.reserve(m_max_blocks);
+}
+
+// BufferPool::Acquire definition
+std::vector<uint8_t> BufferPool::Acquire(size_t size)
+{
+	std::vector<uint8_t> buffer;
+	if (size <= m_block_size)
+	{
+		std::lock_guard lck(m_mutex);
+		if (!m_free_blocks.empty())
+		{
+			buffer = std::move(m_free_blocks.back());
+			m_free_blocks.pop_back();
+			return buffer;
+		}
+	}
+
+	buffer.reserve(std::max(size, m_block_size));
+	return buffer;
+}
+
+// BufferPool::Release definition
+void BufferPool::Release(std::vector<uint8_t> &&buffer)
+{
+	// A buffer that grew for a large send would otherwise stay in the pool
+	// for good and be handed out for requests of a block
+	if (buffer.capacity() < m_block_size || buffer.capacity() > 2 * m_block_size)
+		return;
+
+	buffer.clear();
+	std::lock_guard lck(m_mutex);
+	if (m_free_blocks.size() < m_max_blocks)
+		m_free_blocks.emplace_back(std::move(buffer));
+}
+
+// BufferPool::GetBlockSize definition
+size_t BufferPool::GetBlockSize() const
+{
+	return m_block_size;
+}
+
+// HandlerMemory::Allocate definition
+void *HandlerMemory::Allocate(size_t size)
+{
+	void *pointer = nullptr;
+	if (size <= small_slot_size)
+		pointer = Claim(m_small_slots, small_slot_size, m_small_in_use, small_slot_count);
+	if (!pointer && size <= large_slot_size)
+		pointer = Claim(m_large_slots, large_slot_size, m_large_in_use, large_slot_count);
+	return pointer ? pointer : ::operator new(size);
+}
+
+// HandlerMemory::Deallocate definition
+void HandlerMemory::Deallocate(void *pointer)
+{
+	if (
+        !Release(m_small_slots, small_slot_size, m_small_in_use, small_slot_count, pointer) &&
+        !Release(m_large_slots, large_slot_size, m_large_in_use, large_slot_count, pointer)
+    )
+		::operator delete(pointer);
+}
+
+// HandlerMemory::Claim definition. Returns a free slot, or null if every 
+// slot is in use.
+void *HandlerMemory::Claim(unsigned char *slots, size_t slot_size, std::atomic<bool> *in_use, size_t count)
+{
+	for (size_t i = 0; i != count; ++i)
+	{
+		if (
+            !in_use[i].load(std::memory_order_relaxed) &&
+            !in_use[i].exchange(true, std::memory_order_acquire)
+        )
+			return slots + i * slot_size;
+	}
+	return nullptr;
+}
+
+// HandlerMemory::Release definition. Frees the slot pointer refers to and 
+// returns true, or returns false if pointer is not one of the slots.
+bool HandlerMemory::Release(unsigned char *slots, size_t slot_size, std::atomic<bool> *in_use, size_t count, void *pointer)
+{
+	auto address = reinterpret_cast<uintptr_t>(pointer);
+	auto begin = reinterpret_cast<uintptr_t>(slots);
+	if (address < begin || address >= begin + slot_size * count)
+		return false;
+	in_use[(address - begin) / slot_size].store(false, std::memory_order_release);
+	return true;
+}
+
+// CoarseClock constructor
+CoarseClock::CoarseClock() :
+    m_now(clock_type::now().time_since_epoch().count())
+{
+}
+
+// CoarseClock::Now definition
+CoarseClock::clock_type::time_point CoarseClock::Now() const
+{
+	return clock_type::time_point(clock_type::duration(m_now.load(std::memory_order_relaxed)));
+}
+
+// CoarseClock::Update definition
+CoarseClock::clock_type::time_point CoarseClock::Update()
+{
+	auto now = clock_type::now();
+	Update(now);
+	return now;
+}
+
+// CoarseClock::Update definition with a time point
+void CoarseClock::Update(clock_type::time_point now)
+{
+	m_now.store(now.time_since_epoch().count(), std::memory_order_relaxed);
+}
+
+// TimerWheel::Entry::SetCallback definition
+void TimerWheel::Entry::SetCallback(std::function<void()> callback)
+{
+	m_callback = callback ? std::make_shared<const std::function<void()> >(std::move(callback)) : nullptr;
+}
+
+// TimerWheel::Entry::HasCallback definition
+bool TimerWheel::Entry::HasCallback() const
+{
+	return static_cast<bool>(m_callback);
+}
+
+// TimerWheel constructor
+TimerWheel::TimerWheel(
+    boost::asio::io_context &io_context,
+    CoarseClock &clock,
+    std::chrono::milliseconds tick,
+    size_t slot_count
+) :
+    m_timer(io_context),
+    m_clock(clock),
+    m_tick(tick)
+{
+	// Round the slot count up to a power of two to wrap with a mask
+	size_t count = 1;
+	while (count < slot_count)
+		count <<= 1;
+	m_slots.resize(count, nullptr);
+}
+
+// TimerWheel::Schedule definition
+void TimerWheel::Schedule(Entry &entry, std::chrono::milliseconds delay, std::shared_ptr<void> owner)
+{
+	// Released after the lock, its destructor may cancel entries
+	std::shared_ptr<void> previous_owner;
+	{
+		std::lock_guard lck(m_mutex);
+		if (!m_stopped)
+		{
+			if (entry.m_scheduled)
+				previous_owner = Unlink(entry);
+			StartTick();
+
+			// Count the ticks from the next one, so an entry does not fire 
+			// early. The cached time lags by at most one iteration of the
+			// event loop, and re-arming a timer does not read the clock.
+			auto remaining = delay - (m_next_tick - m_clock.Now());
+			size_t ticks = 1;
+			if (remaining > remaining.zero())
+				ticks += (remaining + m_tick - std::chrono::steady_clock::duration(1)) / m_tick;
+			Link(entry, ticks, std::move(owner));
+			return;
+		}
+	}
+
+	if (entry.m_callback)
+		(*entry.m_callback)();
+}
+
+// TimerWheel::Cancel definition
+void TimerWheel::Cancel(Entry &entry)
+{
+	// Released after the lock, its destructor may cancel entries
+	std::shared_ptr<void> owner;
+	std::lock_guard lck(m_mutex);
+	if (entry.m_scheduled)
+		owner = Unlink(entry);
+}
+
+// TimerWheel::Stop definition
+void TimerWheel::Stop()
+{
+	std::vector<Expired> expired;
+	{
+		std::lock_guard lck(m_mutex);
+		m_stopped = true;
+		boost::system::error_code ec;
+		m_timer.cancel(ec);
+		for (auto &&head : m_slots)
+		{
+			while (head)
+			{
+				Entry &entry = *head;
+				auto owner = Unlink(entry);
+				expired.push_back(Expired{entry.m_callback, std::move(owner)});
+			}
+		}
+	}
+
+	for (auto &&item : expired)
+	{
+		if (item.m_callback)
+			(*item.m_callback)();
+	}
+}
+
+// TimerWheel::Reset definition
+void TimerWheel::Reset()
+{
+	std::lock_guard lck(m_mutex);
+	m_stopped = false;
+}
+
+// TimerWheel::StartTick definition
+void TimerWheel::StartTick()
+{
+	if (m_ticking)
+		return;
+
+	// The wheel was idle, so the cached time may be old
+	m_ticking = true;
+	m_next_tick = m_clock.Update() + m_tick;
+	m_timer.expires_at(m_next_tick);
+	m_timer.async_wait(
+        MakeAllocHandler(
+            *m_handler_memory,
+            [this,memory=m_handler_memory](auto &&ec)
+            {
+                HandleTick(ec);
+            }
+        )
+    );
+}
+
+// TimerWheel::HandleTick definition
+void TimerWheel::HandleTick(const boost::system::error_code &error)
+{
+	{
+		std::lock_guard lck(m_mutex);
+		if (error || m_stopped)
+		{
+			// Cancelled by Stop, the wheel does not advance and the next
+			// Schedule starts ticking again
+			m_ticking = false;
+			return;
+		}
+
+		// Catch up on every tick that has elapsed since the last handler
+		auto now = m_clock.Update();
+		while (m_next_tick <= now)
+		{
+			m_current_slot = (m_current_slot + 1) & (m_slots.size() - 1);
+			Entry *entry = m_slots[m_current_slot];
+			while (entry)
+			{
+				Entry *next = entry->m_next;
+				if (0 == entry->m_rounds)
+				{
+					auto owner = Unlink(*entry);
+					m_expired.push_back(Expired{entry->m_callback, std::move(owner)});
+				}
+				else
+				{
+					--entry->m_rounds;
+				}
+				entry = next;
+			}
+			m_next_tick += m_tick;
+		}
+
+		if (m_scheduled_count)
+		{
+			m_timer.expires_at(m_next_tick);
+			m_timer.async_wait(
+                MakeAllocHandler(
+                    *m_handler_memory,
+                    [this,memory=m_handler_memory](auto &&ec)
+                    {
+                        HandleTick(ec);
+                    }
+                )
+            );
+		}
+		else
+		{
+			m_ticking = false;
+		}
+	}
+
+	for (auto &&item : m_expired)
+	{
+		if (item.m_callback)
+			(*item.m_callback)();
+	}
+	// The owners are released once every callback has run
+	m_expired.clear();
+}
+
+// TimerWheel::Link definition
+void TimerWheel::Link(Entry &entry, size_t ticks, std::shared_ptr<void> &&owner)
+{
+	entry.m_owner = std::move(owner);
+	entry.m_slot = (m_current_slot + ticks) & (m_slots.size() - 1);
+	entry.m_rounds = (ticks - 1) / m_slots.size();
+	entry.m_prev = nullptr;
+	entry.m_next = m_slots[entry.m_slot];
+	if (entry.m_next)
+		entry.m_next->m_prev = &entry;
+	m_slots[entry.m_slot] = &entry;
+	entry.m_scheduled = true;
+	++m_scheduled_count;
+}
+
+// TimerWheel::Unlink definition
+std::shared_ptr<void> TimerWheel::Unlink(Entry &entry)
+{
+	if (entry.m_prev)
+		entry.m_prev->m_next = entry.m_next;
+	else
+		m_slots[entry.m_slot] = entry.m_next;
+	if (entry.m_next)
+		entry.m_next->m_prev = entry.m_prev;
+	entry.m_prev = entry.m_next = nullptr;
+	entry.m_scheduled = false;
+	--m_scheduled_count;
+	return std::move(entry.m_owner);
+}
+
+// ResolverCache constructor
+ResolverCache::ResolverCache(boost::asio::io_context &io_context, std::chrono::seconds time_to_live) :
+    m_io_context(io_context),
+    m_time_to_live(time_to_live)
+{
+}
+
+// ResolverCache::Resolve definition
+void ResolverCache::Resolve(const std::string &host, uint16_t port, handler_type handler)
+{
+	// Numeric addresses need no lookup
+	boost::system::error_code ec;
+	auto address = boost::asio::ip::make_address(host, ec);
+	if (!ec)
+	{
+		auto endpoints = std::make_shared<const endpoints_type>(
+            1, boost::asio::ip::tcp::endpoint(address, port)
+        );
+		boost::asio::post(
+            m_io_context,
+            [handler=std::move(handler),endpoints=std::move(endpoints)]()
+            {
+                handler(boost::system::error_code(), endpoints);
+            }
+        );
+		return;
+	}
+
+    constexpr size_t max_port_length_with_zero_term = 6u;
+    std::array<char, max_port_length_with_zero_term> port_str = {0};
+    std::to_chars(port_str.data(), port_str.data() + port_str.size(), port);
+	std::string key = host + ':' + port_str.data();
+
+	{
+		std::lock_guard lck(m_mutex);
+		auto &&entry = m_entries[key];
+		if (entry.m_endpoints && std::chrono::steady_clock::now() < entry.m_expires)
+		{
+			boost::asio::post(
+                m_io_context,
+                [handler=std::move(handler),endpoints=entry.m_endpoints]()
+                {
+                    handler(boost::system::error_code(), endpoints);
+                }
+            );
+			return;
+		}
+
+		entry.m_waiters.emplace_back(std::move(handler));
+		if (entry.m_resolving)
+			return;
+		entry.m_resolving = true;
+	}
+
+	auto resolver = std::make_shared<boost::asio::ip::tcp::resolver>(m_io_context);
+	resolver->async_resolve(
+        host,
+        port_str.data(),
+        [this,resolver,key=std::move(key)](auto &&ec, auto &&results)
+        {
+            HandleResolve(key, ec, results);
+        }
+    );
+}
+
+// ResolverCache::HandleResolve definition
+void ResolverCache::HandleResolve(
+    const std::string &key,
+    const boost::system::error_code &error,
+    const boost::asio::ip::tcp::resolver::results_type &results
+)
+{
+	std::shared_ptr<const endpoints_type> endpoints;
+	if (!error)
+	{
+		endpoints = std::make_shared<const endpoints_type>(results.begin(), results.end());
+	}
+
+	std::vector<handler_type> waiters;
+	{
+		std::lock_guard lck(m_mutex);
+		auto &&entry = m_entries[key];
+		entry.m_resolving = false;
+		waiters.swap(entry.m_waiters);
+		if (endpoints)
+		{
+			entry.m_endpoints = endpoints;
+			entry.m_expires = std::chrono::steady_clock::now() + m_time_to_live;
+		}
+		else
+		{
+			m_entries.erase(key);
+		}
+	}
+
+	for (auto &&waiter : waiters)
+		waiter(error, endpoints);
+}
+
+// ResolverCache::SetTimeToLive definition
+void ResolverCache::SetTimeToLive(std::chrono::seconds time_to_live)
+{
+	std::lock_guard lck(m_mutex);
+	m_time_to_live = time_to_live;
+}
+
+// ResolverCache::Clear definition
+void ResolverCache::Clear()
+{
+	std::lock_guard lck(m_mutex);
+	for (auto it = m_entries.begin(); it != m_entries.end();)
+	{
+		// Entries with a lookup in flight still have waiters to serve
+		if (it->second.m_resolving)
+		{
+			it->second.m_endpoints.reset();
+			++it;
+		}
+		else
+		{
+			it = m_entries.erase(it);
+		}
+	}
+}
+
+// Hive constructor with concurrency hint
+Hive::Hive(int concurrency_hint) :
+    m_io_context(concurrency_hint)
+{
+}
 
 // Hive::GetContext definition
 boost::asio::io_context &Hive::GetContext()
@@ -10,6 +527,30 @@ boost::asio::io_context &Hive::GetContext()
 	return m_io_context;
 }
 
+// Hive::GetBufferPool definition
+BufferPool &Hive::GetBufferPool()
+{
+	return m_buffer_pool;
+}
+
+// Hive::GetTimerWheel definition
+TimerWheel &Hive::GetTimerWheel()
+{
+	return m_timer_wheel;
+}
+
+// Hive::GetResolverCache definition
+ResolverCache &Hive::GetResolverCache()
+{
+	return m_resolver_cache;
+}
+
+// Hive::GetTime definition
+CoarseClock::clock_type::time_point Hive::GetTime() const
+{
+	return m_clock.Now();
+}
+
 // Hive::HasStopped definition
 bool Hive::HasStopped()
 {
@@ -19,13 +560,41 @@ bool Hive::HasStopped()
 // Hive::Poll definition
 void Hive::Poll()
 {
+	m_clock.Update();
 	m_io_context.poll();
+	if (m_shutdown && m_io_context.stopped())
+		Drain();
 }
 
 // Hive::Run definition
 void Hive::Run()
 {
-	m_io_context.run();
+	// Each iteration waits for one handler and then drains every handler
+	// that is ready, with the cached time refreshed in between.
+	m_runners.fetch_add(1, std::memory_order_relaxed);
+	m_clock.Update();
+	while (m_io_context.run_one())
+	{
+		m_clock.Update();
+		m_io_context.poll();
+	}
+	if (1 == m_runners.fetch_sub(1, std::memory_order_acq_rel) && m_shutdown)
+		Drain();
+}
+
+// Hive::Drain definition. Runs the handlers that became ready after the 
+// io_context was stopped, typically operations aborted by the connections
+// closing during shutdown. Left queued, they would keep their objects and
+// through them this Hive alive. Operations still outstanding are left
+// alone, so this does not block.
+void Hive::Drain()
+{
+	m_io_context.restart();
+	do
+	{
+		m_clock.Update();
+	}
+	while (m_io_context.poll());
 }
 
 // Hive::Stop definition
@@ -35,9 +604,24 @@ void Hive::Stop()
     constexpr bool with = true; // new value to swap with
 	if (m_shutdown.compare_exchange_weak(cmp,with) || false == cmp )
 	{
-		m_work_ptr.reset();
-		m_io_context.run();
-		m_io_context.stop();
+		// Stopped on a thread running this object once the handlers queued
+		// before have run. Running the io_context here as well would run 
+		// handlers of a single threaded Hive on two threads at once. The 
+		// io_context is stopped rather than left to run out of work, since
+		// reads, user timers and other operations without a wheel entry 
+		// would keep Run from returning.
+		boost::asio::post(
+            m_io_context,
+            [this]()
+            {
+                // Skipped if Reset came first
+                if (!m_shutdown)
+                    return;
+                m_work_ptr.reset();
+                m_timer_wheel.Stop();
+                m_io_context.stop();
+            }
+        );
 	}
 }
 
@@ -49,83 +633,229 @@ void Hive::Reset()
 	if (m_shutdown.compare_exchange_weak(cmp,with) || true == cmp)
 	{
 		m_io_context.reset();
+		m_timer_wheel.Reset();
         m_work_ptr = std::make_unique<work_type>(boost::asio::make_work_guard(m_io_context));
 	}
 }
 
-// Acceptor constructor 
-Acceptor::Acceptor(std::shared_ptr<Hive> hive) :
-    m_hive(hive), 
-    m_acceptor(m_hive->GetContext()), 
-    m_io_strand(m_hive->GetContext()), 
-    m_timer(m_hive->GetContext())
+// HivePool constructor
+HivePool::HivePool(size_t hive_count)
 {
+	if (0 == hive_count)
+		hive_count = std::max(1u, std::thread::hardware_concurrency());
+
+	m_hives.reserve(hive_count);
+	for (size_t i = 0; i != hive_count; ++i)
+		m_hives.emplace_back(std::make_shared<Hive>(1));
 }
 
-// Acceptor::StartTimer definition
-void Acceptor::StartTimer()
+// HivePool destructor
+HivePool::~HivePool()
 {
-	m_last_time = boost::posix_time::microsec_clock::local_time();
-	m_timer.expires_from_now(boost::posix_time::milliseconds(m_timer_interval));
-	m_timer.async_wait(
-        boost::asio::bind_executor(
-            m_io_strand,
-            [self=shared_from_this()](auto &&ec) mutable
-            {
-                self->HandleTimer(ec);
-            }
-        )
-    );
+	Stop();
 }
 
-// Acceptor::StartError definition
-void Acceptor::StartError( const boost::system::error_code &error)
+// HivePool::GetSize definition
+size_t HivePool::GetSize() const
 {
-    bool cmp = false; // expected value for compare 
-    constexpr bool with = true; // new value to swap with
-    if (m_error_state.compare_exchange_weak(cmp, with) || false == cmp)
-	{
-		boost::system::error_code ec;
-		m_acceptor.cancel(ec);
-		m_acceptor.close(ec);
-		m_timer.cancel(ec);
-		OnError(error);
-	}
+	return m_hives.size();
 }
 
-// Acceptor::DispatchAccept definition
-void Acceptor::DispatchAccept(std::shared_ptr<Connection> connection)
+// HivePool::GetHive definition
+std::shared_ptr<Hive> HivePool::GetHive(size_t index)
 {
-	m_acceptor.async_accept(
-        connection->GetSocket(),
-        boost::asio::bind_executor(
-            connection->GetStrand(),
-            [self=shared_from_this(),con=connection](auto &&ec) mutable
-            {
-                self->HandleAccept(ec,con);
-            }
-        )
-    );
+	return m_hives.at(index);
 }
 
-// Acceptor::HandleTimer definition
-void Acceptor::HandleTimer(const boost::system::error_code &error)
+// HivePool::GetNextHive definition
+std::shared_ptr<Hive> HivePool::GetNextHive()
 {
-	if (error || HasError() || m_hive->HasStopped())
-    {
-		StartError(error);
-    }
-	else
+	size_t index = m_next_hive.fetch_add(1, std::memory_order_relaxed);
+	return m_hives[index % m_hives.size()];
+}
+
+// HivePool::Run definition
+void HivePool::Run(worker_type worker)
+{
+	if (!worker)
 	{
-		OnTimer(boost::posix_time::microsec_clock::local_time() - m_last_time);
-		StartTimer();
+		worker = [](std::shared_ptr<Hive> hive, size_t)
+		{
+			hive->Run();
+		};
 	}
+
+	m_threads.reserve(m_hives.size());
+	for (size_t i = 0; i != m_hives.size(); ++i)
+		m_threads.emplace_back(worker, m_hives[i], i + 1);
 }
 
-// Acceptor::HandleAccept definition
-void Acceptor::HandleAccept(const boost::system::error_code &error, std::shared_ptr<Connection> connection)
+// HivePool::Stop definition
+void HivePool::Stop()
 {
-	if (error || HasError() || m_hive->HasStopped())
+	// Every Hive shuts down on its own thread, so they all drain their
+	// remaining work in parallel before the first join returns
+	for (auto &&hive : m_hives)
+		hive->Stop();
+
+	for (auto &&th : m_threads)
+	{
+		if (th.joinable())
+			th.join();
+	}
+	m_threads.clear();
+}
+
+// HivePool::Reset definition
+void HivePool::Reset()
+{
+	for (auto &&hive : m_hives)
+		hive->Reset();
+}
+
+// BasicAcceptor constructor 
+template<class Policy>
+BasicAcceptor<Policy>::BasicAcceptor(std::shared_ptr<Hive> hive) :
+    m_hive(hive), 
+    m_acceptor(m_hive->GetContext()), 
+    m_io_strand(Policy::MakeExecutor(m_hive->GetContext()))
+{
+}
+
+// BasicAcceptor destructor
+template<class Policy>
+BasicAcceptor<Policy>::~BasicAcceptor()
+{
+	m_hive->GetTimerWheel().Cancel(m_timer_entry);
+}
+
+// BasicAcceptor::StartTimer definition
+template<class Policy>
+void BasicAcceptor<Policy>::StartTimer()
+{
+	m_last_time = m_hive->GetTime();
+	if (!m_timer_entry.HasCallback())
+	{
+		// The wheel keeps the object alive until the callback has returned
+		m_timer_entry.SetCallback(
+            [this]()
+            {
+                boost::asio::post(
+                    m_io_strand,
+                    MakeAllocHandler(
+                        m_handler_memory,
+                        [self=this->shared_from_this()]()
+                        {
+                            self->HandleTimer(boost::system::error_code());
+                        }
+                    )
+                );
+            }
+        );
+	}
+	m_hive->GetTimerWheel().Schedule(
+        m_timer_entry,
+        std::chrono::milliseconds(m_timer_interval),
+        this->shared_from_this()
+    );
+}
+
+// BasicAcceptor::StartError definition
+template<class Policy>
+void BasicAcceptor<Policy>::StartError( const boost::system::error_code &error)
+{
+    bool cmp = false; // expected value for compare 
+    constexpr bool with = true; // new value to swap with
+    if (m_error_state.compare_exchange_weak(cmp, with) || false == cmp)
+	{
+		if (!IsOrderlyClose(error))
+			Log("Acceptor error: ", error.message());
+		boost::system::error_code ec;
+		m_acceptor.cancel(ec);
+		m_acceptor.close(ec);
+		m_hive->GetTimerWheel().Cancel(m_timer_entry);
+		OnError(error);
+	}
+}
+
+// BasicAcceptor::DispatchAccept definition
+template<class Policy>
+void BasicAcceptor<Policy>::DispatchAccept(std::shared_ptr<connection_type> connection)
+{
+	if (m_resolving)
+	{
+		// Listen has not bound the socket yet
+		m_queued_accepts.emplace_back(std::move(connection));
+		return;
+	}
+
+	++m_outstanding_accepts;
+	m_acceptor.async_accept(
+        connection->GetSocket(),
+        boost::asio::bind_executor(
+            connection->GetStrand(),
+            MakeAllocHandler(
+                connection->m_handler_memory,
+                [self=this->shared_from_this(),con=connection](auto &&ec) mutable
+                {
+                    self->HandleAccept(ec,con);
+                }
+            )
+        )
+    );
+}
+
+// BasicAcceptor::DispatchRefill definition
+template<class Policy>
+void BasicAcceptor<Policy>::DispatchRefill()
+{
+	m_refill_accepts = true;
+	while (
+        m_outstanding_accepts < m_pending_accepts &&
+        m_acceptor.is_open() &&
+        !HasError() &&
+        !m_hive->HasStopped()
+    )
+	{
+		auto connection = CreateConnection();
+		if (!connection)
+		{
+			m_refill_accepts = false;
+			break;
+		}
+		DispatchAccept(std::move(connection));
+	}
+}
+
+// BasicAcceptor::DispatchAcceptDone definition
+template<class Policy>
+void BasicAcceptor<Policy>::DispatchAcceptDone()
+{
+	--m_outstanding_accepts;
+	if (m_refill_accepts)
+		DispatchRefill();
+}
+
+// BasicAcceptor::HandleTimer definition
+template<class Policy>
+void BasicAcceptor<Policy>::HandleTimer(const boost::system::error_code &error)
+{
+	if (error || HasError() || m_hive->HasStopped())
+    {
+		StartError(error);
+    }
+	else
+	{
+		OnTimer(ToTimeDuration(m_hive->GetTime() - m_last_time));
+		StartTimer();
+	}
+}
+
+// BasicAcceptor::HandleAccept definition
+template<class Policy>
+void BasicAcceptor<Policy>::HandleAccept(const boost::system::error_code &error, std::shared_ptr<connection_type> connection)
+{
+	if (error || HasError() || m_hive->HasStopped())
     {
 		connection->StartError(error);
     }
@@ -153,391 +883,1663 @@ void Acceptor::HandleAccept(const boost::system::error_code &error, std::shared_
 			StartError(error);
         }
 	}
+
+	// The accept counters belong to the acceptor's strand
+    boost::asio::post(
+        m_io_strand,
+        MakeAllocHandler(
+            m_handler_memory,
+            [self=this->shared_from_this()]()
+            {
+                self->DispatchAcceptDone();
+            }
+        )
+    );
+}
+
+// BasicAcceptor::Stop definition
+template<class Policy>
+void BasicAcceptor<Policy>::Stop()
+{
+    boost::asio::post(
+        m_io_strand,
+        MakeAllocHandler(
+            m_handler_memory,
+            [self=this->shared_from_this()]()
+            {
+                self->HandleTimer(boost::asio::error::connection_reset);
+            }
+        )
+	);
+}
+
+// BasicAcceptor::Accept definition
+template<class Policy>
+void BasicAcceptor<Policy>::Accept(std::shared_ptr<connection_type> connection)
+{
+    boost::asio::post(
+        m_io_strand,
+        MakeAllocHandler(
+            m_handler_memory,
+            [self=this->shared_from_this(),conn=connection]() mutable
+            {
+                self->DispatchAccept(conn);
+            }
+        )
+    );
+}
+
+// BasicAcceptor::Accept definition with connections from CreateConnection
+template<class Policy>
+void BasicAcceptor<Policy>::Accept()
+{
+    boost::asio::post(
+        m_io_strand,
+        MakeAllocHandler(
+            m_handler_memory,
+            [self=this->shared_from_this()]()
+            {
+                self->DispatchRefill();
+            }
+        )
+    );
+}
+
+// BasicAcceptor::CreateConnection definition
+template<class Policy>
+std::shared_ptr<BasicConnection<Policy> > BasicAcceptor<Policy>::CreateConnection()
+{
+	return nullptr;
+}
+
+// BasicAcceptor::Listen definition
+template<class Policy>
+void BasicAcceptor<Policy>::Listen(const std::string &host, const uint16_t &port)
+{
+	boost::system::error_code ec;
+	auto address = boost::asio::ip::make_address(host, ec);
+	if (!ec)
+	{
+		StartListen(boost::asio::ip::tcp::endpoint(address, port));
+		return;
+	}
+
+	m_resolving = true;
+	m_hive->GetResolverCache().Resolve(
+        host,
+        port,
+        [self=this->shared_from_this()](auto &&ec, auto &&endpoints) mutable
+        {
+            auto &&strand = self->m_io_strand;
+            auto &&memory = self->m_handler_memory;
+            boost::asio::post(
+                strand,
+                MakeAllocHandler(
+                    memory,
+                    [self=std::move(self),ec,endpoints]()
+                    {
+                        self->HandleResolve(ec, endpoints);
+                    }
+                )
+            );
+        }
+    );
+}
+
+// BasicAcceptor::StartListen definition
+template<class Policy>
+void BasicAcceptor<Policy>::StartListen(const boost::asio::ip::tcp::endpoint &endpoint)
+{
+	m_acceptor.open(endpoint.protocol());
+	m_acceptor.set_option(boost::asio::ip::tcp::acceptor::reuse_address(true));
+	if (m_reuse_port)
+	{
+#if defined(SO_REUSEPORT)
+		m_acceptor.set_option(reuse_port(true));
+#else
+		throw boost::system::system_error(boost::asio::error::operation_not_supported);
+#endif
+	}
+	m_acceptor.bind(endpoint);
+	m_acceptor.listen(boost::asio::socket_base::max_connections);
+	StartTimer();
+}
+
+// BasicAcceptor::HandleResolve definition
+template<class Policy>
+void BasicAcceptor<Policy>::HandleResolve(
+    const boost::system::error_code &error,
+    std::shared_ptr<const ResolverCache::endpoints_type> endpoints
+)
+{
+	m_resolving = false;
+	auto queued_accepts = std::move(m_queued_accepts);
+	m_queued_accepts.clear();
+
+	boost::system::error_code ec = error;
+	if (!ec && endpoints->empty())
+		ec = boost::asio::error::host_not_found;
+	if (!ec && !HasError() && !m_hive->HasStopped())
+	{
+		try
+		{
+			StartListen(endpoints->front());
+		}
+		catch (boost::system::system_error &e)
+		{
+			ec = e.code();
+		}
+	}
+
+	if (ec || HasError() || m_hive->HasStopped())
+	{
+		StartError(ec);
+		for (auto &&connection : queued_accepts)
+			connection->StartError(ec);
+		return;
+	}
+
+	for (auto &&connection : queued_accepts)
+		DispatchAccept(std::move(connection));
+	if (m_refill_accepts)
+		DispatchRefill();
+}
+
+// BasicAcceptor::GetHive definition
+template<class Policy>
+std::shared_ptr<Hive> BasicAcceptor<Policy>::GetHive()
+{
+	return m_hive;
+}
+
+// BasicAcceptor::GetAcceptor definition
+template<class Policy>
+boost::asio::ip::tcp::acceptor &BasicAcceptor<Policy>::GetAcceptor()
+{
+	return m_acceptor;
+}
+
+// BasicAcceptor::GetStrand definition
+template<class Policy>
+typename BasicAcceptor<Policy>::executor_type &BasicAcceptor<Policy>::GetStrand()
+{
+	return m_io_strand;
+}
+
+// BasicAcceptor::SetPendingAccepts definition
+template<class Policy>
+void BasicAcceptor<Policy>::SetPendingAccepts(int32_t pending_accepts)
+{
+	m_pending_accepts = pending_accepts;
+}
+
+// BasicAcceptor::GetPendingAccepts definition
+template<class Policy>
+int32_t BasicAcceptor<Policy>::GetPendingAccepts() const
+{
+	return m_pending_accepts;
+}
+
+// BasicAcceptor::SetReusePort definition
+template<class Policy>
+void BasicAcceptor<Policy>::SetReusePort(bool reuse_port)
+{
+	m_reuse_port = reuse_port;
+}
+
+// BasicAcceptor::GetReusePort definition
+template<class Policy>
+bool BasicAcceptor<Policy>::GetReusePort() const
+{
+	return m_reuse_port;
+}
+
+// BasicAcceptor::GetTimerInterval definition
+template<class Policy>
+int32_t BasicAcceptor<Policy>::GetTimerInterval() const
+{
+	return m_timer_interval;
+}
+
+// BasicAcceptor::SetTimerInterval definition
+template<class Policy>
+void BasicAcceptor<Policy>::SetTimerInterval(int32_t timer_interval)
+{
+	m_timer_interval = timer_interval;
+}
+
+// BasicAcceptor::HasError definition
+template<class Policy>
+bool BasicAcceptor<Policy>::HasError()
+{
+	return m_error_state;
+}
+
+// Explicit instantiations of BasicAcceptor for the policies of wrapper.h
+template class BasicAcceptor<MultiThreaded>;
+template class BasicAcceptor<SingleThreaded>;
+
+// BasicConnection constructor
+template<class Policy>
+BasicConnection<Policy>::BasicConnection(std::shared_ptr<Hive> hive) :
+    m_hive(hive),
+    m_socket(m_hive->GetContext()),
+    m_io_strand(Policy::MakeExecutor(m_hive->GetContext()))
+{
+}
+
+// BasicConnection destructor
+template<class Policy>
+BasicConnection<Policy>::~BasicConnection()
+{
+	m_hive->GetTimerWheel().Cancel(m_timer_entry);
+	m_hive->GetBufferPool().Release(std::move(m_recv_buffer));
+}
+
+// BasicConnection::StrandRef constructor
+template<class Policy>
+BasicConnection<Policy>::StrandRef::StrandRef(BasicConnection *connection) :
+    m_connection(connection)
+{
+	if (0 == m_connection->m_strand_refs++)
+		m_connection->m_strand_owner = m_connection->shared_from_this();
+}
+
+// BasicConnection::StrandRef move constructor
+template<class Policy>
+BasicConnection<Policy>::StrandRef::StrandRef(StrandRef &&rhs) noexcept :
+    m_connection(rhs.m_connection)
+{
+	rhs.m_connection = nullptr;
+}
+
+// BasicConnection::StrandRef destructor
+template<class Policy>
+BasicConnection<Policy>::StrandRef::~StrandRef()
+{
+	if (m_connection && 0 == --m_connection->m_strand_refs)
+	{
+		// The connection may be destroyed along with the last reference
+		auto owner = std::move(m_connection->m_strand_owner);
+	}
+}
+
+// BasicConnection::Bind definition
+template<class Policy>
+void BasicConnection<Policy>::Bind(const std::string &ip, uint16_t port)
+{
+	boost::asio::ip::tcp::endpoint endpoint(boost::asio::ip::address::from_string(ip), port);
+	m_socket.open(endpoint.protocol());
+	m_socket.set_option(boost::asio::ip::tcp::acceptor::reuse_address(true));
+	m_socket.bind(endpoint);
+	m_bind_endpoint = endpoint;
+}
+
+// BasicConnection::Reset definition
+template<class Policy>
+void BasicConnection<Policy>::Reset()
+{
+	boost::system::error_code ec;
+	m_socket.close(ec);
+
+	// The callback refers to the previous owner of the object
+	m_hive->GetTimerWheel().Cancel(m_timer_entry);
+	m_timer_entry.SetCallback(nullptr);
+
+	ReleaseSends();
+	m_queued_send_bytes = 0;
+	m_write_blocked = false;
+	m_pending_recvs.clear();
+	m_recv_stalled = false;
+	m_recv_paused = false;
+	m_recv_buffer.clear();
+	m_recv_offset = m_recv_keep_begin = m_recv_keep_end = 0;
+	m_connect_endpoints.reset();
+	m_bind_endpoint.reset();
+	m_error_state = false;
+
+	OnReset();
+}
+
+// BasicConnection::OnReset definition
+template<class Policy>
+void BasicConnection<Policy>::OnReset()
+{
+}
+
+// BasicConnection::OnWriteBlocked definition
+template<class Policy>
+void BasicConnection<Policy>::OnWriteBlocked()
+{
+}
+
+// BasicConnection::OnDrain definition
+template<class Policy>
+void BasicConnection<Policy>::OnDrain()
+{
+}
+
+// BasicConnection::ReleaseSends definition
+template<class Policy>
+void BasicConnection<Policy>::ReleaseSends()
+{
+	auto &&pool = m_hive->GetBufferPool();
+	while (!m_pending_sends.empty())
+	{
+		auto &&pending = m_pending_sends.front();
+		m_queued_send_bytes.fetch_sub(pending.Get().size(), std::memory_order_relaxed);
+		pool.Release(std::move(pending.m_owned));
+		m_pending_sends.pop_front();
+	}
+	m_send_buffers.clear();
+}
+
+// BasicConnection::StartSend definition
+template<class Policy>
+void BasicConnection<Policy>::StartSend()
+{
+	m_send_buffers.clear();
+	if (!m_pending_sends.empty())
+	{
+		// Gather as many queued buffers as the limits allow into one write
+		size_t total_bytes = 0;
+		for (size_t i = 0; i != m_pending_sends.size(); ++i)
+		{
+			auto &&buffer = m_pending_sends[i].Get();
+			if (
+                m_send_buffers.size() == Policy::max_send_buffers ||
+                (!m_send_buffers.empty() && total_bytes + buffer.size() > Policy::max_send_bytes)
+            )
+				break;
+			m_send_buffers.emplace_back(boost::asio::buffer(buffer));
+			total_bytes += buffer.size();
+		}
+
+		boost::asio::async_write(
+            m_socket,
+            ConstBufferRange{
+                m_send_buffers.data(),
+                m_send_buffers.data() + m_send_buffers.size()
+            },
+            boost::asio::bind_executor(
+                m_io_strand,
+                MakeAllocHandler(
+                    m_handler_memory,
+                    [
+                        self=StrandRef(this),
+                        count=m_send_buffers.size()
+                    ] (auto &&ec, auto &&...)
+                    {
+                        self->HandleSend(ec, count);
+                    }
+                )
+            )
+        );
+	}
+}
+
+// BasicConnection::StartRecv definition
+template<class Policy>
+void BasicConnection<Policy>::StartRecv(int32_t total_bytes)
+{
+	size_t size = total_bytes > 0 ? total_bytes : m_receive_buffer_size;
+	size_t kept = m_recv_keep_end - m_recv_keep_begin;
+	if (kept && m_recv_keep_begin >= static_cast<size_t>(m_receive_buffer_size))
+	{
+		std::memmove(m_recv_buffer.data(), m_recv_buffer.data() + m_recv_keep_begin, kept);
+		m_recv_keep_begin = 0;
+		m_recv_keep_end = kept;
+	}
+	else if (!kept)
+	{
+		m_recv_keep_begin = m_recv_keep_end = 0;
+	}
+
+	size_t offset = m_recv_keep_end;
+	if (!offset && m_recv_buffer.capacity() < size)
+	{
+		// The previous buffer was handed out by OnRecv or is too small
+		auto &&pool = m_hive->GetBufferPool();
+		pool.Release(std::move(m_recv_buffer));
+		m_recv_buffer = pool.Acquire(size);
+	}
+	m_recv_buffer.resize(offset + size);
+
+	if(total_bytes > 0)
+	{
+		boost::asio::async_read(
+            m_socket,
+            boost::asio::buffer(m_recv_buffer.data() + offset, size),
+            boost::asio::bind_executor(
+                m_io_strand,
+                MakeAllocHandler(
+                    m_handler_memory,
+                    [self=StrandRef(this)] (auto &&ec, auto &&bytes)
+                    {
+                        self->HandleRecv(ec, bytes);
+                    }
+                )
+            )
+        );
+	}
+	else
+	{
+		m_socket.async_read_some(
+            boost::asio::buffer(m_recv_buffer.data() + offset, size),
+            boost::asio::bind_executor(
+                m_io_strand,
+                MakeAllocHandler(
+                    m_handler_memory,
+                    [self=StrandRef(this)] (auto &&ec, auto &&bytes)
+                    {
+                        self->HandleRecv(ec, bytes);
+                    }
+                )
+            )
+        );
+	}
+}
+
+// BasicConnection::StartTimer definition
+template<class Policy>
+void BasicConnection<Policy>::StartTimer()
+{
+	m_last_time = m_hive->GetTime();
+	if (!m_timer_entry.HasCallback())
+	{
+		// The wheel keeps the object alive until the callback has returned
+		m_timer_entry.SetCallback(
+            [this]()
+            {
+                DispatchTimer(this->shared_from_this());
+            }
+        );
+	}
+	m_hive->GetTimerWheel().Schedule(
+        m_timer_entry,
+        std::chrono::milliseconds(m_timer_interval),
+        this->shared_from_this()
+    );
+}
+
+// BasicConnection::StartError definition
+template<class Policy>
+void BasicConnection<Policy>::StartError(const boost::system::error_code &error)
+{
+    bool cmp = false; // expected value for compare 
+    constexpr bool with = true; // new value to swap with
+    if (m_error_state.compare_exchange_weak(cmp, with) || false == cmp)
+	{
+		boost::system::error_code ec;
+		if (!IsOrderlyClose(error))
+		{
+			auto endpoint = m_socket.remote_endpoint(ec);
+			if (ec)
+				Log("Connection error: ", error.message());
+			else
+				Log("Connection to ", endpoint.address().to_string(), ':', endpoint.port(), " error: ", error.message());
+		}
+		m_socket.shutdown(boost::asio::ip::tcp::socket::shutdown_both, ec);
+		m_socket.close(ec);
+		m_hive->GetTimerWheel().Cancel(m_timer_entry);
+		OnError(error);
+	}
+}
+
+// BasicConnection::HandleResolve definition
+template<class Policy>
+void BasicConnection<Policy>::HandleResolve(
+    const boost::system::error_code &error,
+    std::shared_ptr<const ResolverCache::endpoints_type> endpoints
+)
+{
+	if(error || HasError() || m_hive->HasStopped())
+    {
+		StartError(error);
+    }
+	else if (endpoints->empty())
+	{
+		StartError(boost::asio::error::host_not_found);
+	}
+	else
+	{
+		m_connect_endpoints = std::move(endpoints);
+		StartConnect(0);
+	}
+}
+
+// BasicConnection::ReopenSocket definition
+template<class Policy>
+void BasicConnection<Policy>::ReopenSocket(boost::system::error_code &ec)
+{
+	// A failed connect leaves the socket unusable, start with a new one
+	m_socket.close(ec);
+	ec.clear();
+	if (m_bind_endpoint)
+	{
+		m_socket.open(m_bind_endpoint->protocol(), ec);
+		if (!ec)
+			m_socket.set_option(boost::asio::ip::tcp::acceptor::reuse_address(true), ec);
+		if (!ec)
+			m_socket.bind(*m_bind_endpoint, ec);
+	}
+}
+
+// BasicConnection::StartConnect definition
+template<class Policy>
+void BasicConnection<Policy>::StartConnect(size_t endpoint_index)
+{
+	if (endpoint_index > 0)
+	{
+		boost::system::error_code ec;
+		ReopenSocket(ec);
+		if (ec)
+		{
+			StartError(ec);
+			return;
+		}
+	}
+
+	m_socket.async_connect(
+        (*m_connect_endpoints)[endpoint_index],
+        boost::asio::bind_executor(
+            m_io_strand,
+            MakeAllocHandler(
+                m_handler_memory,
+                [self=StrandRef(this),endpoint_index](auto &&ec)
+                {
+                    self->HandleConnect(ec, endpoint_index);
+                }
+            )
+        )
+    );
+}
+
+// BasicConnection::HandleConnect definition
+template<class Policy>
+void BasicConnection<Policy>::HandleConnect(const boost::system::error_code &error, size_t endpoint_index)
+{
+	if (
+        error &&
+        error != boost::asio::error::operation_aborted &&
+        !HasError() &&
+        !m_hive->HasStopped() &&
+        endpoint_index + 1 < m_connect_endpoints->size()
+    )
+	{
+		// Fall back to the next resolved endpoint
+		StartConnect(endpoint_index + 1);
+	}
+	else if(error || HasError() || m_hive->HasStopped())
+    {
+		StartError( error );
+    }
+	else
+	{
+		if(m_socket.is_open())
+			OnConnect( m_socket.remote_endpoint().address().to_string(), m_socket.remote_endpoint().port() );
+		else
+			StartError( error );
+	}
+}
+
+// BasicConnection::HandleSend definition
+template<class Policy>
+void BasicConnection<Policy>::HandleSend(const boost::system::error_code &error, size_t buffer_count)
+{
+	if(error || HasError() || m_hive->HasStopped())
+    {
+		StartError(error);
+
+		// Nothing is going to be written anymore
+		ReleaseSends();
+    }
+	else
+	{
+		// Retire every buffer that was part of the completed write. OnSend
+		// may queue more data right away with SingleThreaded, so the entry
+		// leaves the queue first, and m_send_buffers stays set until the 
+		// next write starts.
+		size_t sent_bytes = 0;
+		for (size_t i = 0; i != buffer_count; ++i)
+		{
+			PendingSend pending = std::move(m_pending_sends.front());
+			m_pending_sends.pop_front();
+			sent_bytes += pending.Get().size();
+			OnSend(pending.Get());
+			m_hive->GetBufferPool().Release(std::move(pending.m_owned));
+		}
+		size_t queued_bytes = m_queued_send_bytes.fetch_sub(sent_bytes, std::memory_order_relaxed) - sent_bytes;
+		StartSend();
+
+		if (m_write_blocked && queued_bytes <= m_send_low_watermark)
+		{
+			m_write_blocked = false;
+			OnDrain();
+		}
+	}
+}
+
+// BasicConnection::HandleRecv definition
+template<class Policy>
+void BasicConnection<Policy>::HandleRecv(const boost::system::error_code &error, int32_t actual_bytes)
+{
+
+	if(error || HasError() || m_hive->HasStopped())
+    {
+		StartError( error );
+    }
+	else
+	{
+		m_recv_buffer.resize(m_recv_keep_end + actual_bytes);
+		m_recv_offset = m_recv_keep_begin;
+		m_recv_keep_begin = m_recv_keep_end = 0;
+		OnRecv(m_recv_buffer);
+		m_recv_offset = 0;
+		m_pending_recvs.pop_front();
+		if(m_pending_recvs.empty() && m_continuous_recv && !HasError())
+			m_pending_recvs.push_back(0);
+		if(!m_pending_recvs.empty())
+			StartNextRecv();
+	}
+}
+
+// BasicConnection::HandleTimer definition
+template<class Policy>
+void BasicConnection<Policy>::HandleTimer(const boost::system::error_code &error)
+{
+	if(error || HasError() || m_hive->HasStopped())
+    {
+		StartError( error );
+    }
+	else if (
+        m_write_blocked && m_slow_consumer_timeout > 0 &&
+        m_hive->GetTime() - m_write_blocked_time >= std::chrono::milliseconds(m_slow_consumer_timeout)
+    )
+	{
+		// The peer does not read fast enough, stop buffering for it
+		StartError(boost::asio::error::timed_out);
+	}
+	else
+	{
+		OnTimer(ToTimeDuration(m_hive->GetTime() - m_last_time));
+		StartTimer();
+	}
+}
+
+// BasicConnection::DispatchSend definition
+template<class Policy>
+void BasicConnection<Policy>::DispatchSend(std::vector<uint8_t> &&buffer)
+{
+	m_queued_send_bytes.fetch_add(buffer.size(), std::memory_order_relaxed);
+	EnqueueSend(PendingSend{std::move(buffer), nullptr});
+}
+
+// BasicConnection::DispatchSend definition for shared buffers
+template<class Policy>
+void BasicConnection<Policy>::DispatchSend(SharedBuffer &&buffer)
+{
+	m_queued_send_bytes.fetch_add(buffer->size(), std::memory_order_relaxed);
+	EnqueueSend(PendingSend{{}, std::move(buffer)});
+}
+
+// BasicConnection::EnqueueSend definition. The bytes of pending have already 
+// been added to m_queued_send_bytes.
+template<class Policy>
+void BasicConnection<Policy>::EnqueueSend(PendingSend &&pending)
+{
+	if (HasError())
+	{
+		// Nothing is written anymore, so do not let the queue grow
+		m_queued_send_bytes.fetch_sub(pending.Get().size(), std::memory_order_relaxed);
+		m_hive->GetBufferPool().Release(std::move(pending.m_owned));
+		return;
+	}
+
+	// A write is in progress while m_send_buffers is set
+	bool should_start_send = m_send_buffers.empty();
+	m_pending_sends.push_back(std::move(pending));
+	if(should_start_send)
+		StartSend();
+
+	if (!m_write_blocked && m_queued_send_bytes.load(std::memory_order_relaxed) >= m_send_high_watermark)
+	{
+		m_write_blocked = true;
+		m_write_blocked_time = m_hive->GetTime();
+		OnWriteBlocked();
+	}
+}
+
+// BasicConnection::DispatchRecv definition
+template<class Policy>
+void BasicConnection<Policy>::DispatchRecv(int32_t total_bytes)
+{
+	bool should_start_receive = m_pending_recvs.empty();
+	m_pending_recvs.push_back(total_bytes);
+	if(should_start_receive)
+		StartNextRecv();
+}
+
+// BasicConnection::DispatchResumeRecv definition
+template<class Policy>
+void BasicConnection<Policy>::DispatchResumeRecv()
+{
+	if (m_recv_stalled && !m_recv_paused.load(std::memory_order_relaxed))
+	{
+		m_recv_stalled = false;
+		StartNextRecv();
+	}
+}
+
+// BasicConnection::StartNextRecv definition. Starts the read at the front of 
+// the pending receives, or leaves it for ResumeRecv while paused.
+template<class Policy>
+void BasicConnection<Policy>::StartNextRecv()
+{
+	if (m_recv_paused.load(std::memory_order_relaxed))
+		m_recv_stalled = true;
+	else
+		StartRecv(m_pending_recvs.front());
+}
+
+// BasicConnection::DispatchTimer definition. Takes over the reference that
+// the timer callback has taken, rather than taking another one.
+template<class Policy>
+void BasicConnection<Policy>::DispatchTimer(std::shared_ptr<BasicConnection> &&self)
+{
+    boost::asio::post(
+        m_io_strand,
+        MakeAllocHandler(
+            m_handler_memory,
+            [self=std::move(self)]()
+            {
+                self->HandleTimer(boost::system::error_code());
+            }
+        )
+    );
+}
+
+// BasicConnection::Connect definition
+template<class Policy>
+void BasicConnection<Policy>::Connect(const std::string & host, uint16_t port)
+{
+	m_hive->GetResolverCache().Resolve(
+        host,
+        port,
+        [self=this->shared_from_this()](auto &&ec, auto &&endpoints) mutable
+        {
+            auto &&strand = self->m_io_strand;
+            auto &&memory = self->m_handler_memory;
+            boost::asio::post(
+                strand,
+                MakeAllocHandler(
+                    memory,
+                    [self=std::move(self),ec,endpoints]()
+                    {
+                        self->HandleResolve(ec, endpoints);
+                    }
+                )
+            );
+        }
+    );
+	StartTimer();
+}
+
+#if defined(BOOST_ASIO_HAS_CO_AWAIT)
+// BasicConnection::AsyncConnect definition
+template<class Policy>
+boost::asio::awaitable<void> BasicConnection<Policy>::AsyncConnect(std::string host, uint16_t port)
+{
+	auto self = this->shared_from_this();
+
+	// async_initiate takes the completion token by non-const reference
+	boost::asio::use_awaitable_t<> token;
+	using resolve_signature = void(
+        boost::system::error_code,
+        std::shared_ptr<const ResolverCache::endpoints_type>
+    );
+	// host is a parameter of this coroutine and lives in its frame until 
+	// the resolve completes
+	auto endpoints = co_await boost::asio::async_initiate<boost::asio::use_awaitable_t<>, resolve_signature>(
+        [this,&host,port](auto handler)
+        {
+            // The cache invokes its handlers outside of the strand and needs
+            // them copyable
+            auto executor = boost::asio::get_associated_executor(handler, m_io_strand);
+            auto shared_handler = std::make_shared<decltype(handler)>(std::move(handler));
+            m_hive->GetResolverCache().Resolve(
+                host,
+                port,
+                [executor,shared_handler](auto &&ec, auto &&endpoints)
+                {
+                    boost::asio::post(
+                        executor,
+                        [shared_handler,ec,endpoints]()
+                        {
+                            (*shared_handler)(ec, endpoints);
+                        }
+                    );
+                }
+            );
+        },
+        token
+    );
+
+	boost::system::error_code ec = boost::asio::error::host_not_found;
+	for (size_t i = 0; i != endpoints->size(); ++i)
+	{
+		if (i > 0)
+		{
+			ReopenSocket(ec);
+			if (ec)
+				break;
+		}
+		co_await m_socket.async_connect((*endpoints)[i], boost::asio::redirect_error(token, ec));
+		if (!ec || HasError() || m_hive->HasStopped())
+			break;
+	}
+	if (ec)
+		throw boost::system::system_error(ec);
+
+	StartTimer();
+}
+
+// BasicConnection::ReadSome definition
+template<class Policy>
+boost::asio::awaitable<size_t> BasicConnection<Policy>::ReadSome(boost::asio::mutable_buffer buffer)
+{
+	auto self = this->shared_from_this();
+	co_return co_await m_socket.async_read_some(buffer, boost::asio::use_awaitable);
+}
+
+// BasicConnection::ReadExactly definition
+template<class Policy>
+boost::asio::awaitable<std::vector<uint8_t> > BasicConnection<Policy>::ReadExactly(size_t total_bytes)
+{
+	auto self = this->shared_from_this();
+	auto buffer = m_hive->GetBufferPool().Acquire(total_bytes);
+	buffer.resize(total_bytes);
+	co_await boost::asio::async_read(m_socket, boost::asio::buffer(buffer), boost::asio::use_awaitable);
+	co_return buffer;
+}
+#endif
+
+// BasicConnection::Disconnect definition
+template<class Policy>
+void BasicConnection<Policy>::Disconnect()
+{
+    boost::asio::post(
+        m_io_strand,
+        MakeAllocHandler(
+            m_handler_memory,
+            [self=this->shared_from_this()]()
+            {
+                self->HandleTimer(boost::asio::error::connection_reset);
+            }
+        )
+    );
+}
+
+// BasicConnection::Recv definition
+template<class Policy>
+void BasicConnection<Policy>::Recv(int32_t total_bytes)
+{
+    if constexpr (Policy::direct_calls)
+    {
+        DispatchRecv(total_bytes);
+    }
+    else
+    {
+        boost::asio::post(
+            m_io_strand,
+            MakeAllocHandler(
+                m_handler_memory,
+                [self=this->shared_from_this(),bytes=total_bytes]()
+                {
+                    self->DispatchRecv(bytes);
+                }
+            )
+        );
+    }
+}
+
+// BasicConnection::SetContinuousRecv definition
+template<class Policy>
+void BasicConnection<Policy>::SetContinuousRecv(bool continuous)
+{
+	m_continuous_recv = continuous;
+}
+
+// BasicConnection::IsContinuousRecv definition
+template<class Policy>
+bool BasicConnection<Policy>::IsContinuousRecv() const
+{
+	return m_continuous_recv;
+}
+
+// BasicConnection::PauseRecv definition
+template<class Policy>
+void BasicConnection<Policy>::PauseRecv()
+{
+	m_recv_paused = true;
+}
+
+// BasicConnection::ResumeRecv definition
+template<class Policy>
+void BasicConnection<Policy>::ResumeRecv()
+{
+	m_recv_paused = false;
+    boost::asio::post(
+        m_io_strand,
+        MakeAllocHandler(
+            m_handler_memory,
+            [self=this->shared_from_this()]()
+            {
+                self->DispatchResumeRecv();
+            }
+        )
+    );
+}
+
+// BasicConnection::IsRecvPaused definition
+template<class Policy>
+bool BasicConnection<Policy>::IsRecvPaused() const
+{
+	return m_recv_paused;
+}
+
+// BasicConnection::Send definition
+template<class Policy>
+size_t BasicConnection<Policy>::Send(const std::vector<uint8_t> &buffer)
+{
+    auto copy = m_hive->GetBufferPool().Acquire(buffer.size());
+    copy.assign(buffer.begin(), buffer.end());
+    return Send(std::move(copy));
+}
+
+// BasicConnection::Send definition with move semantics
+template<class Policy>
+size_t BasicConnection<Policy>::Send(std::vector<uint8_t> &&buffer)
+{
+    size_t size = buffer.size();
+    size_t queued_bytes = m_queued_send_bytes.fetch_add(size, std::memory_order_relaxed) + size;
+    if constexpr (Policy::direct_calls)
+    {
+        EnqueueSend(PendingSend{std::move(buffer), nullptr});
+    }
+    else
+    {
+        boost::asio::post(
+            m_io_strand,
+            MakeAllocHandler(
+                m_handler_memory,
+                [self=this->shared_from_this(),buf=std::move(buffer)]() mutable
+                {
+                    self->EnqueueSend(PendingSend{std::move(buf), nullptr});
+                }
+            )
+        );
+    }
+    return queued_bytes;
+}
+
+// BasicConnection::Send definition for shared buffers
+template<class Policy>
+size_t BasicConnection<Policy>::Send(SharedBuffer buffer)
+{
+    size_t size = buffer->size();
+    size_t queued_bytes = m_queued_send_bytes.fetch_add(size, std::memory_order_relaxed) + size;
+    if constexpr (Policy::direct_calls)
+    {
+        EnqueueSend(PendingSend{{}, std::move(buffer)});
+    }
+    else
+    {
+        boost::asio::post(
+            m_io_strand,
+            MakeAllocHandler(
+                m_handler_memory,
+                [self=this->shared_from_this(),buf=std::move(buffer)]() mutable
+                {
+                    self->EnqueueSend(PendingSend{{}, std::move(buf)});
+                }
+            )
+        );
+    }
+    return queued_bytes;
+}
+
+// BasicConnection::GetQueuedSendBytes definition
+template<class Policy>
+size_t BasicConnection<Policy>::GetQueuedSendBytes() const
+{
+	return m_queued_send_bytes.load(std::memory_order_relaxed);
+}
+
+// BasicConnection::SetSendWatermarks definition
+template<class Policy>
+void BasicConnection<Policy>::SetSendWatermarks(size_t low, size_t high)
+{
+	if (low > high)
+		throw boost::system::system_error(boost::asio::error::invalid_argument);
+	m_send_low_watermark = low;
+	m_send_high_watermark = high;
 }
 
-// Acceptor::Stop definition
-void Acceptor::Stop()
+// BasicConnection::GetSendLowWatermark definition
+template<class Policy>
+size_t BasicConnection<Policy>::GetSendLowWatermark() const
 {
-    boost::asio::post(
-        m_io_strand,
-        [self=shared_from_this()]()
-        {
-            self->HandleTimer(boost::asio::error::connection_reset);
-        }
-	);
+	return m_send_low_watermark;
 }
 
-// Acceptor::Accept definition
-void Acceptor::Accept(std::shared_ptr<Connection> connection)
+// BasicConnection::GetSendHighWatermark definition
+template<class Policy>
+size_t BasicConnection<Policy>::GetSendHighWatermark() const
 {
-    boost::asio::post(
-        m_io_strand,
-        [self=shared_from_this(),conn=connection]() mutable
-        {
-            self->DispatchAccept(conn);
-        }
-    );
+	return m_send_high_watermark;
 }
 
-// Acceptor::Listen definition
-void Acceptor::Listen(const std::string &host, const uint16_t &port)
+// BasicConnection::SetSlowConsumerTimeout definition
+template<class Policy>
+void BasicConnection<Policy>::SetSlowConsumerTimeout(int32_t timeout_ms)
 {
-	boost::asio::ip::tcp::resolver resolver(m_hive->GetContext());
-    constexpr size_t max_port_length_with_zero_term = 6u;
-    std::array<char, max_port_length_with_zero_term> port_str = {0};
-    std::to_chars(port_str.data(), port_str.data() + port_str.size(), port);
-	boost::asio::ip::tcp::resolver::query query(host, port_str.data());
-	boost::asio::ip::tcp::endpoint endpoint = *resolver.resolve(query);
-	m_acceptor.open(endpoint.protocol());
-	m_acceptor.set_option(boost::asio::ip::tcp::acceptor::reuse_address(true));
-	m_acceptor.bind(endpoint);
-	m_acceptor.listen(boost::asio::socket_base::max_connections);
-	StartTimer();
+	m_slow_consumer_timeout = timeout_ms;
+}
+
+// BasicConnection::GetSlowConsumerTimeout definition
+template<class Policy>
+int32_t BasicConnection<Policy>::GetSlowConsumerTimeout() const
+{
+	return m_slow_consumer_timeout;
+}
+
+// BasicConnection::GetSocket definition
+template<class Policy>
+boost::asio::ip::tcp::socket &BasicConnection<Policy>::GetSocket()
+{
+	return m_socket;
+}
+
+// BasicConnection::GetStrand definition
+template<class Policy>
+typename BasicConnection<Policy>::executor_type &BasicConnection<Policy>::GetStrand()
+{
+	return m_io_strand;
+}
+
+// BasicConnection::KeepRecv definition
+template<class Policy>
+void BasicConnection<Policy>::KeepRecv(size_t offset, size_t count)
+{
+	m_recv_keep_begin = offset;
+	m_recv_keep_end = offset + count;
 }
 
-// Acceptor::GetHive definition
-std::shared_ptr<Hive> Acceptor::GetHive()
+// BasicConnection::GetRecvOffset definition
+template<class Policy>
+size_t BasicConnection<Policy>::GetRecvOffset() const
+{
+	return m_recv_offset;
+}
+
+// BasicConnection::GetHive definition
+template<class Policy>
+std::shared_ptr<Hive> BasicConnection<Policy>::GetHive()
 {
 	return m_hive;
 }
 
-// Acceptor::GetAcceptor definition
-boost::asio::ip::tcp::acceptor &Acceptor::GetAcceptor()
+// BasicConnection::SetReceiveBufferSize definition
+template<class Policy>
+void BasicConnection<Policy>::SetReceiveBufferSize(int32_t size)
 {
-	return m_acceptor;
+	m_receive_buffer_size = size;
+}
+
+// BasicConnection::GetReceiveBufferSize definition
+template<class Policy>
+int32_t BasicConnection<Policy>::GetReceiveBufferSize() const
+{
+	return m_receive_buffer_size;
 }
 
-// Acceptor::GetTimerInterval definition
-int32_t Acceptor::GetTimerInterval() const
+// BasicConnection::GetTimerInterval definition
+template<class Policy>
+int32_t BasicConnection<Policy>::GetTimerInterval() const
 {
 	return m_timer_interval;
 }
 
-// Acceptor::SetTimerInterval definition
-void Acceptor::SetTimerInterval(int32_t timer_interval)
+// BasicConnection::SetTimerInterval definition
+template<class Policy>
+void BasicConnection<Policy>::SetTimerInterval(int32_t timer_interval)
 {
 	m_timer_interval = timer_interval;
 }
 
-// Acceptor::HasError definition
-bool Acceptor::HasError()
+// BasicConnection::HasError definition
+template<class Policy>
+bool BasicConnection<Policy>::HasError()
 {
 	return m_error_state;
 }
 
-// Connection constructor
-Connection::Connection(std::shared_ptr<Hive> hive) :
-    m_hive(hive),
-    m_socket(m_hive->GetContext()),
-    m_io_strand(m_hive->GetContext()),
-    m_timer(m_hive->GetContext())
-{
-}
+// Explicit instantiations of BasicConnection for the policies of wrapper.h
+template class BasicConnection<MultiThreaded>;
+template class BasicConnection<SingleThreaded>;
 
-// Connection::Bind definition
-void Connection::Bind(const std::string &ip, uint16_t port)
+// ConnectionGroup::Bucket constructor
+ConnectionGroup::Bucket::Bucket(std::shared_ptr<Hive> hive) :
+    m_hive(std::move(hive)),
+    m_strand(boost::asio::make_strand(m_hive->GetContext()))
 {
-	boost::asio::ip::tcp::endpoint endpoint(boost::asio::ip::address::from_string(ip), port);
-	m_socket.open(endpoint.protocol());
-	m_socket.set_option(boost::asio::ip::tcp::acceptor::reuse_address(true));
-	m_socket.bind(endpoint);
 }
 
-// Connection::StartSend definition
-void Connection::StartSend()
+// ConnectionGroup::Bucket::Insert definition
+void ConnectionGroup::Bucket::Insert(std::shared_ptr<Connection> &&connection)
 {
-	if (!m_pending_sends.empty())
+	if (m_positions.emplace(connection.get(), m_members.size()).second)
 	{
-		boost::asio::async_write(
-            m_socket,
-            boost::asio::buffer(m_pending_sends.front()),
-            boost::asio::bind_executor(
-                m_io_strand,
-                [
-                    self=shared_from_this(),
-                    send_buffer_it=m_pending_sends.begin()
-                ] (auto &&ec, auto &&...)
-                {
-                    self->HandleSend(ec,send_buffer_it);
-                }
-            )
-        );
+		m_members.push_back(std::move(connection));
+		m_size.store(m_members.size(), std::memory_order_relaxed);
 	}
 }
 
-// Connection::StartRecv definition
-void Connection::StartRecv(int32_t total_bytes)
+// ConnectionGroup::Bucket::Erase definition
+void ConnectionGroup::Bucket::Erase(size_t index)
 {
-	if(total_bytes > 0)
+	m_positions.erase(m_members[index].get());
+	if (index + 1 != m_members.size())
 	{
-		m_recv_buffer.resize(total_bytes);
-		boost::asio::async_read(
-            m_socket,
-            boost::asio::buffer(m_recv_buffer),
-            boost::asio::bind_executor(
-                m_io_strand,
-                [self=shared_from_this()] (auto &&ec, auto &&bytes)
-                {
-                    self->HandleRecv(ec, bytes);
-                }
-            )
-        );
+		m_members[index] = std::move(m_members.back());
+		m_positions[m_members[index].get()] = index;
 	}
-	else
+	m_members.pop_back();
+	m_size.store(m_members.size(), std::memory_order_relaxed);
+}
+
+// ConnectionGroup::Bucket::Send definition
+void ConnectionGroup::Bucket::Send(const SharedBuffer &buffer, const Connection *except)
+{
+	size_t index = 0;
+	while (index != m_members.size())
 	{
-		m_recv_buffer.resize(m_receive_buffer_size);
-		m_socket.async_read_some(
-            boost::asio::buffer(m_recv_buffer), 
-            boost::asio::bind_executor(
-                m_io_strand,
-                [self=shared_from_this()] (auto &&ec, auto &&bytes)
-                {
-                    self->HandleRecv(ec, bytes);
-                }
-            )
-        );
+		auto &&member = m_members[index];
+		if (member->HasError())
+		{
+			// Erase moves the last member into this slot
+			Erase(index);
+			continue;
+		}
+		if (member.get() != except)
+		{
+			// Not running on the member's strand yet, but on its io_context:
+			// an idle strand runs the handler right here
+			boost::asio::dispatch(
+                member->m_io_strand,
+                MakeAllocHandler(
+                    member->m_handler_memory,
+                    [connection=member,buf=buffer]() mutable
+                    {
+                        connection->DispatchSend(std::move(buf));
+                    }
+                )
+            );
+		}
+		++index;
 	}
 }
 
-// Connection::StartTimer definition
-void Connection::StartTimer()
+// ConnectionGroup::GetBucket definition
+std::shared_ptr<ConnectionGroup::Bucket> ConnectionGroup::GetBucket(const std::shared_ptr<Hive> &hive)
 {
-	m_last_time = boost::posix_time::microsec_clock::local_time();
-	m_timer.expires_from_now(boost::posix_time::milliseconds(m_timer_interval));
-	m_timer.async_wait(
-        boost::asio::bind_executor(
-            m_io_strand,
-            [self=shared_from_this()] (auto &&ec)
+	std::lock_guard lck(m_mutex);
+	auto &&bucket = m_buckets[hive.get()];
+	if (!bucket)
+		bucket = std::make_shared<Bucket>(hive);
+	return bucket;
+}
+
+// ConnectionGroup::Add definition
+void ConnectionGroup::Add(std::shared_ptr<Connection> connection)
+{
+	auto bucket = GetBucket(connection->GetHive());
+	boost::asio::post(
+        bucket->m_strand,
+        MakeAllocHandler(
+            bucket->m_handler_memory,
+            [bucket,connection=std::move(connection)]() mutable
             {
-                self->DispatchTimer(ec);
+                bucket->Insert(std::move(connection));
             }
         )
     );
 }
 
-// Connection::StartError definition
-void Connection::StartError(const boost::system::error_code &error)
+// ConnectionGroup::Remove definition
+void ConnectionGroup::Remove(const std::shared_ptr<Connection> &connection)
 {
-    bool cmp = false; // expected value for compare 
-    constexpr bool with = true; // new value to swap with
-    if (m_error_state.compare_exchange_weak(cmp, with) || false == cmp)
-	{
-		boost::system::error_code ec;
-		m_socket.shutdown(boost::asio::ip::tcp::socket::shutdown_both, ec);
-		m_socket.close(ec);
-		m_timer.cancel(ec);
-		OnError(error);
-	}
+	auto bucket = GetBucket(connection->GetHive());
+	boost::asio::post(
+        bucket->m_strand,
+        MakeAllocHandler(
+            bucket->m_handler_memory,
+            [bucket,connection=connection.get()]()
+            {
+                auto position = bucket->m_positions.find(connection);
+                if (position != bucket->m_positions.end())
+                    bucket->Erase(position->second);
+            }
+        )
+    );
 }
 
-// Connection::HandleConnect definition
-void Connection::HandleConnect(const boost::system::error_code &error)
+// ConnectionGroup::Clear definition
+void ConnectionGroup::Clear()
 {
-	if(error || HasError() || m_hive->HasStopped())
-    {
-		StartError( error );
-    }
-	else
+	std::lock_guard lck(m_mutex);
+	for (auto &&entry : m_buckets)
 	{
-		if(m_socket.is_open())
-			OnConnect( m_socket.remote_endpoint().address().to_string(), m_socket.remote_endpoint().port() );
-		else
-			StartError( error );
+		boost::asio::post(
+            entry.second->m_strand,
+            MakeAllocHandler(
+                entry.second->m_handler_memory,
+                [bucket=entry.second]()
+                {
+                    bucket->m_members.clear();
+                    bucket->m_positions.clear();
+                    bucket->m_size.store(0, std::memory_order_relaxed);
+                }
+            )
+        );
 	}
 }
 
-// Connection::HandleSend definition
-void Connection::HandleSend(const boost::system::error_code &error, std::list<std::vector<uint8_t> >::iterator itr)
+// ConnectionGroup::Broadcast definition
+void ConnectionGroup::Broadcast(SharedBuffer buffer, const Connection *except)
 {
-	if(error || HasError() || m_hive->HasStopped())
-    {
-		StartError(error);
-    }
-	else
+	std::lock_guard lck(m_mutex);
+	for (auto &&entry : m_buckets)
 	{
-		OnSend(*itr);
-		m_pending_sends.erase(itr);
-		StartSend();
+		boost::asio::post(
+            entry.second->m_strand,
+            MakeAllocHandler(
+                entry.second->m_handler_memory,
+                [bucket=entry.second,buffer,except]()
+                {
+                    bucket->Send(buffer, except);
+                }
+            )
+        );
 	}
 }
 
-// Connection::HandleRecv definition
-void Connection::HandleRecv(const boost::system::error_code &error, int32_t actual_bytes)
+// ConnectionGroup::Broadcast definition with a copied buffer
+void ConnectionGroup::Broadcast(const std::vector<uint8_t> &buffer, const Connection *except)
 {
+	Broadcast(std::make_shared<const std::vector<uint8_t> >(buffer), except);
+}
 
-	if(error || HasError() || m_hive->HasStopped())
-    {
-		StartError( error );
-    }
-	else
-	{
-		m_recv_buffer.resize(actual_bytes);
-		OnRecv(m_recv_buffer);
-		m_pending_recvs.pop_front();
-		if(!m_pending_recvs.empty())
-			StartRecv( std::move(m_pending_recvs.front()) );
-	}
+// ConnectionGroup::GetSize definition
+size_t ConnectionGroup::GetSize() const
+{
+	std::lock_guard lck(m_mutex);
+	size_t size = 0;
+	for (auto &&entry : m_buckets)
+		size += entry.second->m_size.load(std::memory_order_relaxed);
+	return size;
 }
 
-// Connection::HandleTimer definition
-void Connection::HandleTimer(const boost::system::error_code &error)
+// FramedConnection constructor
+FramedConnection::FramedConnection(std::shared_ptr<Hive> hive) :
+    Connection(hive)
 {
-	if(error || HasError() || m_hive->HasStopped())
-    {
-		StartError( error );
-    }
-	else
-	{
-		OnTimer(boost::posix_time::microsec_clock::local_time() - m_last_time);
-		StartTimer();
-	}
 }
 
-// Connection::DispatchSend definition
-void Connection::DispatchSend(std::vector<uint8_t> &&buffer)
+// FramedConnection::SetHeaderType definition
+void FramedConnection::SetHeaderType(HeaderType header_type)
 {
-	bool should_start_send = m_pending_sends.empty();
-	m_pending_sends.emplace_back(std::move(buffer));
-	if(should_start_send)
-		StartSend();
+	m_header_type = header_type;
 }
 
-// Connection::DispatchRecv definition
-void Connection::DispatchRecv(int32_t total_bytes)
+// FramedConnection::GetHeaderType definition
+FramedConnection::HeaderType FramedConnection::GetHeaderType() const
 {
-	bool should_start_receive = m_pending_recvs.empty();
-	m_pending_recvs.push_back(total_bytes);
-	if(should_start_receive)
-		StartRecv(total_bytes);
+	return m_header_type;
 }
 
-// Connection::DispatchTimer definition
-void Connection::DispatchTimer(const boost::system::error_code &error)
+// FramedConnection::SetByteOrder definition
+void FramedConnection::SetByteOrder(ByteOrder byte_order)
 {
-    boost::asio::post(
-        m_io_strand,
-        [self=shared_from_this(),ec=error]()
-        {
-            self->HandleTimer(ec);
-        }
-    );
+	m_byte_order = byte_order;
 }
 
-// Connection::Connect definition
-void Connection::Connect(const std::string & host, uint16_t port)
+// FramedConnection::GetByteOrder definition
+FramedConnection::ByteOrder FramedConnection::GetByteOrder() const
 {
-	boost::system::error_code ec;
-	boost::asio::ip::tcp::resolver resolver(m_hive->GetContext());
-    constexpr size_t max_port_length_with_zero_term = 6u;
-    std::array<char, max_port_length_with_zero_term> port_str = {0};
-    std::to_chars(port_str.data(), port_str.data() + port_str.size(), port);
-	boost::asio::ip::tcp::resolver::query query(host, port_str.data());
-	boost::asio::ip::tcp::resolver::iterator iterator = resolver.resolve(query);
-	m_socket.async_connect(
-        *iterator,
-        boost::asio::bind_executor(
-            m_io_strand,
-            [self=shared_from_this()](auto &&ec)
-            {
-                self->HandleConnect(ec);
-            }
-        )
-    );
-	StartTimer();
+	return m_byte_order;
 }
 
-// Connection::Disconnect definition
-void Connection::Disconnect()
+// FramedConnection::SetMaxFrameSize definition
+void FramedConnection::SetMaxFrameSize(size_t max_frame_size)
 {
-    boost::asio::post(
-        m_io_strand,
-        [self=shared_from_this()]()
-        {
-            self->HandleTimer(boost::asio::error::connection_reset);
-        }
-    );
+	m_max_frame_size = max_frame_size;
 }
 
-// Connection::Recv definition
-void Connection::Recv(int32_t total_bytes)
+// FramedConnection::GetMaxFrameSize definition
+size_t FramedConnection::GetMaxFrameSize() const
 {
-    boost::asio::post(
-        m_io_strand,
-        [self=shared_from_this(),bytes=total_bytes]()
-        {
-            self->DispatchRecv(bytes);
-        }
-    );
+	return m_max_frame_size;
 }
 
-// Connection::Send definition
-void Connection::Send(const std::vector<uint8_t> &buffer)
+// FramedConnection::SendFrame definition
+void FramedConnection::SendFrame(boost::asio::const_buffer payload)
 {
-    boost::asio::post(
-        m_io_strand,
-        [self=shared_from_this(),buf=buffer]() mutable
-        {
-            self->DispatchSend(std::move(buf));
-        }
-	);
+	// A fixed size prefix holds at most 8, 16 or 32 bits of the length
+	uint64_t length = payload.size();
+	uint64_t max_length = m_max_frame_size;
+	if (HeaderType::uint8 == m_header_type)
+		max_length = std::min<uint64_t>(max_length, std::numeric_limits<uint8_t>::max());
+	else if (HeaderType::uint16 == m_header_type)
+		max_length = std::min<uint64_t>(max_length, std::numeric_limits<uint16_t>::max());
+	else if (HeaderType::uint32 == m_header_type)
+		max_length = std::min<uint64_t>(max_length, std::numeric_limits<uint32_t>::max());
+	if (length > max_length)
+		throw boost::system::system_error(boost::asio::error::message_size);
+
+	std::array<uint8_t, 10> header;
+	size_t header_size = 0;
+	if (HeaderType::varint == m_header_type)
+	{
+		do
+		{
+			header[header_size++] = static_cast<uint8_t>((length & 0x7f) | (length > 0x7f ? 0x80 : 0));
+			length >>= 7;
+		} while (length);
+	}
+	else
+	{
+		header_size = HeaderType::uint8 == m_header_type ? 1 : HeaderType::uint16 == m_header_type ? 2 : 4;
+		for (size_t i = 0; i != header_size; ++i)
+		{
+			size_t shift = ByteOrder::big_endian == m_byte_order ? header_size - 1 - i : i;
+			header[i] = static_cast<uint8_t>(length >> (8 * shift));
+		}
+	}
+
+	auto buffer = GetHive()->GetBufferPool().Acquire(header_size + payload.size());
+	auto data = static_cast<const uint8_t *>(payload.data());
+	buffer.insert(buffer.end(), header.begin(), header.begin() + header_size);
+	buffer.insert(buffer.end(), data, data + payload.size());
+	Send(std::move(buffer));
 }
 
-// Connection::Send definition with move semantics
-void Connection::Send(std::vector<uint8_t> &&buffer)
+// FramedConnection::ParseHeader definition
+size_t FramedConnection::ParseHeader(const uint8_t *data, size_t size, uint64_t &length) const
 {
-    boost::asio::post(
-        m_io_strand,
-        [self=shared_from_this(),buf=std::move(buffer)]() mutable
-        {
-            self->DispatchSend(std::move(buf));
-        }
-	);
+	if (HeaderType::varint == m_header_type)
+	{
+		// A 64 bit value takes at most 10 bytes, the last one holds its top
+		// bit only
+		length = 0;
+		for (size_t i = 0; i != size; ++i)
+		{
+			if (9 == i && data[i] > 1)
+				return malformed_header;
+			length |= static_cast<uint64_t>(data[i] & 0x7f) << (7 * i);
+			if (!(data[i] & 0x80))
+				return i + 1;
+		}
+		return 0;
+	}
+
+	size_t header_size = HeaderType::uint8 == m_header_type ? 1 : HeaderType::uint16 == m_header_type ? 2 : 4;
+	if (size < header_size)
+		return 0;
+	length = 0;
+	for (size_t i = 0; i != header_size; ++i)
+	{
+		size_t shift = ByteOrder::big_endian == m_byte_order ? header_size - 1 - i : i;
+		length |= static_cast<uint64_t>(data[i]) << (8 * shift);
+	}
+	return header_size;
 }
 
-// Connection::GetSocket definition
-boost::asio::ip::tcp::socket &Connection::GetSocket()
+// FramedConnection::OnRecv definition
+void FramedConnection::OnRecv(std::vector<uint8_t> &buffer)
 {
-	return m_socket;
+	size_t offset = GetRecvOffset();
+	const uint8_t *data = buffer.data() + offset;
+	size_t size = buffer.size() - offset;
+	size_t position = 0;
+	while (position < size)
+	{
+		uint64_t length = 0;
+		size_t header_size = ParseHeader(data + position, size - position, length);
+		if (!header_size)
+			break;
+		if (malformed_header == header_size)
+		{
+			StartError(boost::asio::error::invalid_argument);
+			return;
+		}
+		if (length > m_max_frame_size)
+		{
+			StartError(boost::asio::error::message_size);
+			return;
+		}
+		if (size - position - header_size < length)
+			break;
+
+		OnFrame(boost::asio::const_buffer(data + position + header_size, length));
+		if (HasError())
+			return;
+		position += header_size + length;
+	}
+
+	if (position < size)
+		KeepRecv(offset + position, size - position);
+
+	// Queued behind the receive being completed, so it starts without 
+	// another trip through the strand
+	DispatchRecv(0);
 }
 
-// Connection::GetStrand definition
-boost::asio::io_context::strand &Connection::GetStrand()
+// DelimitedConnection constructor
+DelimitedConnection::DelimitedConnection(std::shared_ptr<Hive> hive) :
+    Connection(hive)
 {
-	return m_io_strand;
 }
 
-// Connection::GetHive definition
-std::shared_ptr<Hive> Connection::GetHive()
+// DelimitedConnection::SetDelimiter definition
+void DelimitedConnection::SetDelimiter(std::string_view delimiter)
 {
-	return m_hive;
+	if (delimiter.empty())
+		throw boost::system::system_error(boost::asio::error::invalid_argument);
+	m_delimiter = delimiter;
+	m_scanned = 0;
 }
 
-// Connection::SetReceiveBufferSize definition
-void Connection::SetReceiveBufferSize(int32_t size)
+// DelimitedConnection::GetDelimiter definition
+const std::string &DelimitedConnection::GetDelimiter() const
 {
-	m_receive_buffer_size = size;
+	return m_delimiter;
 }
 
-// Connection::GetReceiveBufferSize definition
-int32_t Connection::GetReceiveBufferSize() const
+// DelimitedConnection::SetMaxMessageSize definition
+void DelimitedConnection::SetMaxMessageSize(size_t max_message_size)
 {
-	return m_receive_buffer_size;
+	m_max_message_size = max_message_size;
 }
 
-// Connection::GetTimerInterval definition
-int32_t Connection::GetTimerInterval() const
+// DelimitedConnection::GetMaxMessageSize definition
+size_t DelimitedConnection::GetMaxMessageSize() const
 {
-	return m_timer_interval;
+	return m_max_message_size;
 }
 
-// Connection::SetTimerInterval definition
-void Connection::SetTimerInterval(int32_t timer_interval)
+// DelimitedConnection::Find definition
+size_t DelimitedConnection::Find(const uint8_t *data, size_t size, std::string_view delimiter)
 {
-	m_timer_interval = timer_interval;
+	auto delim = reinterpret_cast<const uint8_t *>(delimiter.data());
+	size_t n = delimiter.size();
+	if (!n || size < n)
+		return size;
+
+	// Positions up to end may start a delimiter. A vector of positions is
+	// tested at once by comparing them with the first byte and the bytes
+	// n - 1 further with the last byte of the delimiter; only positions 
+	// that match both are compared in full.
+	size_t end = size - n + 1;
+	size_t middle = n > 2 ? n - 2 : 0;
+	size_t i = 0;
+
+	// Returns the position of the first candidate of mask that is a full 
+	// match, bit k standing for position i + k
+	auto verify = [data,delim,middle](size_t i, uint64_t mask) -> size_t
+	{
+		for (; mask; mask &= mask - 1)
+		{
+			size_t position = i + __builtin_ctzll(mask);
+			if (!std::memcmp(data + position + 1, delim + 1, middle))
+				return position;
+		}
+		return std::string_view::npos;
+	};
+#if defined(__AVX2__)
+	const __m256i first32 = _mm256_set1_epi8(static_cast<char>(delim[0]));
+	const __m256i last32 = _mm256_set1_epi8(static_cast<char>(delim[n - 1]));
+	auto match32 = [&](size_t i)
+	{
+		__m256i head = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+		__m256i tail = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i + n - 1));
+		return _mm256_and_si256(_mm256_cmpeq_epi8(head, first32), _mm256_cmpeq_epi8(tail, last32));
+	};
+	// Two vectors per iteration, as most blocks have no candidate at all
+	for (; i + 64 <= end; i += 64)
+	{
+		__m256i low = match32(i);
+		__m256i high = match32(i + 32);
+		__m256i any = _mm256_or_si256(low, high);
+		if (_mm256_testz_si256(any, any))
+			continue;
+		uint64_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(low)) |
+            static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(high))) << 32;
+		size_t position = verify(i, mask);
+		if (std::string_view::npos != position)
+			return position;
+	}
+	for (; i + 32 <= end; i += 32)
+	{
+		size_t position = verify(i, static_cast<uint32_t>(_mm256_movemask_epi8(match32(i))));
+		if (std::string_view::npos != position)
+			return position;
+	}
+#endif
+#if defined(__SSE2__)
+	const __m128i first16 = _mm_set1_epi8(static_cast<char>(delim[0]));
+	const __m128i last16 = _mm_set1_epi8(static_cast<char>(delim[n - 1]));
+	auto match16 = [&](size_t i)
+	{
+		__m128i head = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+		__m128i tail = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i + n - 1));
+		return _mm_and_si128(_mm_cmpeq_epi8(head, first16), _mm_cmpeq_epi8(tail, last16));
+	};
+	// Four vectors per iteration, as most blocks have no candidate at all
+	for (; i + 64 <= end; i += 64)
+	{
+		__m128i m0 = match16(i);
+		__m128i m1 = match16(i + 16);
+		__m128i m2 = match16(i + 32);
+		__m128i m3 = match16(i + 48);
+		__m128i any = _mm_or_si128(_mm_or_si128(m0, m1), _mm_or_si128(m2, m3));
+		if (!_mm_movemask_epi8(any))
+			continue;
+		uint64_t mask = static_cast<uint64_t>(_mm_movemask_epi8(m0)) |
+            static_cast<uint64_t>(_mm_movemask_epi8(m1)) << 16 |
+            static_cast<uint64_t>(_mm_movemask_epi8(m2)) << 32 |
+            static_cast<uint64_t>(_mm_movemask_epi8(m3)) << 48;
+		size_t position = verify(i, mask);
+		if (std::string_view::npos != position)
+			return position;
+	}
+	for (; i + 16 <= end; i += 16)
+	{
+		size_t position = verify(i, static_cast<uint32_t>(_mm_movemask_epi8(match16(i))));
+		if (std::string_view::npos != position)
+			return position;
+	}
+#endif
+	// Scalar fallback and the remaining positions. memchr skips quickly to
+	// the candidates.
+	while (i < end)
+	{
+		auto found = static_cast<const uint8_t *>(std::memchr(data + i, delim[0], end - i));
+		if (!found)
+			break;
+		size_t position = found - data;
+		if (!std::memcmp(found + 1, delim + 1, n - 1))
+			return position;
+		i = position + 1;
+	}
+	return size;
 }
 
-// Connection::HasError definition
-bool Connection::HasError()
+// DelimitedConnection::OnRecv definition
+void DelimitedConnection::OnRecv(std::vector<uint8_t> &buffer)
 {
-	return m_error_state;
+	size_t offset = GetRecvOffset();
+	const uint8_t *data = buffer.data() + offset;
+	size_t size = buffer.size() - offset;
+	size_t position = 0;
+	while (true)
+	{
+		// Bytes of the message scanned by a previous chunk are skipped
+		size_t scan = position + m_scanned;
+		size_t found = scan + Find(data + scan, size - scan, m_delimiter);
+		if (found == size)
+			break;
+		m_scanned = 0;
+		if (found - position > m_max_message_size)
+		{
+			StartError(boost::asio::error::message_size);
+			return;
+		}
+
+		// OnMessage may switch to another delimiter for the next message
+		size_t next = found + m_delimiter.size();
+		OnMessage(boost::asio::const_buffer(data + position, found - position));
+		if (HasError())
+			return;
+		position = next;
+	}
+
+	size_t remaining = size - position;
+	if (remaining)
+	{
+		// The last bytes may be the beginning of a delimiter, so they are 
+		// scanned again once more data arrives
+		m_scanned = remaining - std::min(remaining, m_delimiter.size() - 1);
+		if (m_scanned > m_max_message_size)
+		{
+			StartError(boost::asio::error::message_size);
+			return;
+		}
+		KeepRecv(offset + position, remaining);
+	}
+	else
+	{
+		m_scanned = 0;
+	}
+
+	// Queued behind the receive being completed, so it starts without 
+	// another trip through the strand
+	DispatchRecv(0);
+}
+
+// DelimitedConnection::OnReset definition
+void DelimitedConnection::OnReset()
+{
+	m_scanned = 0;
 }
@@ -3,26 +3,503 @@
 #define _WRAPPER_H_
 
 // Include the required header files
+// <utility> comes first, boost 1.74's awaitable.hpp uses std::exchange
+// without including it
+#include <utility>
 #include <boost/asio.hpp>
 #include <boost/current_function.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
 #include <memory>
 #include <string>
+#include <string_view>
 #include <vector>
-#include <list>
 #include <cstdint>
 #include <atomic>
+#include <thread>
+#include <functional>
+#include <mutex>
+#include <chrono>
+#include <optional>
+#include <unordered_map>
+#include <limits>
 
 // Class declaration
 class Hive;
-class Acceptor;
-class Connection;
+template<class Policy> class BasicAcceptor;
+template<class Policy> class BasicConnection;
+class FramedConnection;
+class DelimitedConnection;
+class HttpClientConnection;
+class HttpServerConnection;
+class HivePool;
+class ConnectionGroup;
+template<class T> class ConnectionPool;
+
+// Class RingQueue definition. A FIFO queue stored in a power of two sized
+// circular buffer. The storage only grows, so once it has reached the
+// working set size of its owner, pushing and popping never allocates.
+// Popped slots are reset to a default constructed value so that they do 
+// not keep resources alive.
+template<class T>
+class RingQueue
+{
+public:
+	RingQueue() = default;
+
+	// Returns true if the queue holds no element.
+	bool empty() const
+	{
+		return m_head == m_tail;
+	}
+
+	// Returns the number of elements in the queue.
+	size_t size() const
+	{
+		return m_tail - m_head;
+	}
+
+	// Returns the number of elements the queue can hold without growing.
+	size_t capacity() const
+	{
+		return m_storage.size();
+	}
+
+	// Returns the index-th element counted from the front.
+	T &operator[](size_t index)
+	{
+		return m_storage[(m_head + index) & (m_storage.size() - 1)];
+	}
+
+	const T &operator[](size_t index) const
+	{
+		return m_storage[(m_head + index) & (m_storage.size() - 1)];
+	}
+
+	T &front()
+	{
+		return (*this)[0];
+	}
+
+	const T &front() const
+	{
+		return (*this)[0];
+	}
+
+	// Appends an element to the back of the queue.
+	void push_back(T &&value)
+	{
+		if (size() == capacity())
+			Grow();
+		m_storage[m_tail++ & (m_storage.size() - 1)] = std::move(value);
+	}
+
+	void push_back(const T &value)
+	{
+		push_back(T(value));
+	}
+
+	// Removes the front element.
+	void pop_front()
+	{
+		front() = T();
+		++m_head;
+	}
+
+	// Removes every element and keeps the storage.
+	void clear()
+	{
+		while (!empty())
+			pop_front();
+		m_head = m_tail = 0;
+	}
+
+	// Grows the storage so that at least count elements fit.
+	void reserve(size_t count)
+	{
+		while (capacity() < count)
+			Grow();
+	}
+
+private:
+	void Grow()
+	{
+		std::vector<T> storage(m_storage.empty() ? 8u : m_storage.size() * 2);
+		size_t count = size();
+		for (size_t i = 0; i != count; ++i)
+			storage[i] = std::move((*this)[i]);
+		m_storage.swap(storage);
+		m_head = 0;
+		m_tail = count;
+	}
+
+private:
+	std::vector<T> m_storage;
+	size_t m_head{0};
+	size_t m_tail{0};
+};
+
+// Immutable byte buffer shared by reference. Connection::Send queues the
+// reference only, so a payload sent to many connections is stored once and
+// lives until the last of them has written it.
+using SharedBuffer = std::shared_ptr<const std::vector<uint8_t> >;
+
+// Class BufferPool definition and its members declaration. The pool keeps
+// released byte buffers of at least GetBlockSize() capacity and leases them
+// out again, so that buffers travelling from a receive to a send and back
+// are recycled instead of being freed and allocated for every message.
+class BufferPool
+{
+public:
+	explicit BufferPool(size_t block_size = 4096, size_t max_blocks = 1024);
+	virtual ~BufferPool() = default;
+
+	BufferPool(const BufferPool & rhs) = delete;
+	BufferPool & operator =(const BufferPool & rhs) = delete;
+
+	// Returns an empty buffer whose capacity is at least size bytes. Requests 
+	// up to the block size are served from the pool when possible.
+	std::vector<uint8_t> Acquire(size_t size);
+
+	// Gives a buffer back to the pool. Buffers that are smaller than the 
+	// block size or larger than twice the block size, or that do not fit 
+	// into the pool anymore, are freed.
+	void Release(std::vector<uint8_t> &&buffer);
+
+	// Returns the capacity of the pooled buffers.
+	size_t GetBlockSize() const;
+
+private:
+	std::mutex m_mutex;
+	std::vector<std::vector<uint8_t> > m_free_blocks;
+	size_t m_block_size;
+	size_t m_max_blocks;
+};
+
+// Class HandlerMemory definition and its members declaration. Recycles 
+// the memory of the completion handlers of one Acceptor or Connection, 
+// which always has a few of them outstanding: the read, the write, and the
+// posts to its strand. Handlers are placed in fixed size slots and only go
+// to the heap when every slot is taken or they do not fit. The large slots
+// hold the operation of a gathered write, which carries its buffer array.
+// Slots are claimed with an atomic flag, as Send and Recv create handlers
+// on the calling thread.
+class HandlerMemory
+{
+public:
+	HandlerMemory() = default;
+	virtual ~HandlerMemory() = default;
+
+	HandlerMemory(const HandlerMemory & rhs) = delete;
+	HandlerMemory & operator =(const HandlerMemory & rhs) = delete;
+
+	// Returns memory for a handler of size bytes.
+	void *Allocate(size_t size);
+
+	// Releases memory returned by Allocate.
+	void Deallocate(void *pointer);
+
+private:
+	static constexpr size_t small_slot_size = 256;
+	static constexpr size_t small_slot_count = 6;
+	static constexpr size_t large_slot_size = 1024;
+	static constexpr size_t large_slot_count = 2;
+
+	static void *Claim(unsigned char *slots, size_t slot_size, std::atomic<bool> *in_use, size_t count);
+	static bool Release(unsigned char *slots, size_t slot_size, std::atomic<bool> *in_use, size_t count, void *pointer);
+
+private:
+	alignas(std::max_align_t) unsigned char m_small_slots[small_slot_count * small_slot_size];
+	alignas(std::max_align_t) unsigned char m_large_slots[large_slot_count * large_slot_size];
+	std::atomic<bool> m_small_in_use[small_slot_count]{};
+	std::atomic<bool> m_large_in_use[large_slot_count]{};
+};
+
+// Class HandlerAllocator definition. The allocator associated with the
+// handlers wrapped by AllocHandler, drawing from a HandlerMemory.
+template<class T>
+class HandlerAllocator
+{
+	template<class U> friend class HandlerAllocator;
+
+public:
+	using value_type = T;
+
+	explicit HandlerAllocator(HandlerMemory &memory) noexcept :
+        m_memory(&memory)
+	{}
+
+	template<class U>
+	HandlerAllocator(const HandlerAllocator<U> &other) noexcept :
+        m_memory(other.m_memory)
+	{}
+
+	T *allocate(size_t count)
+	{
+		return static_cast<T *>(m_memory->Allocate(sizeof(T) * count));
+	}
+
+	void deallocate(T *pointer, size_t /*count*/)
+	{
+		m_memory->Deallocate(pointer);
+	}
+
+	template<class U>
+	bool operator ==(const HandlerAllocator<U> &rhs) const noexcept
+	{
+		return m_memory == rhs.m_memory;
+	}
+
+	template<class U>
+	bool operator !=(const HandlerAllocator<U> &rhs) const noexcept
+	{
+		return m_memory != rhs.m_memory;
+	}
+
+private:
+	HandlerMemory *m_memory;
+};
+
+// Class AllocHandler definition. Wraps a completion handler so that asio
+// allocates its operation from a HandlerMemory, through the handler's 
+// associated allocator. The handler must keep the owner of the memory 
+// alive, which the handlers of the wrapper do by holding a shared_ptr to
+// their object; asio releases the memory before it destroys the handler.
+template<class Handler>
+class AllocHandler
+{
+public:
+	using allocator_type = HandlerAllocator<Handler>;
+
+	AllocHandler(HandlerMemory &memory, Handler handler) :
+        m_memory(&memory),
+        m_handler(std::move(handler))
+	{}
+
+	allocator_type get_allocator() const noexcept
+	{
+		return allocator_type(*m_memory);
+	}
+
+	template<class ...Args>
+	void operator()(Args &&...args)
+	{
+		m_handler(std::forward<Args>(args)...);
+	}
+
+private:
+	HandlerMemory *m_memory;
+	Handler m_handler;
+};
+
+// Returns handler wrapped in an AllocHandler that allocates from memory.
+template<class Handler>
+AllocHandler<std::decay_t<Handler> > MakeAllocHandler(HandlerMemory &memory, Handler &&handler)
+{
+	return AllocHandler<std::decay_t<Handler> >(memory, std::forward<Handler>(handler));
+}
+
+// Class CoarseClock definition and its members declaration. A monotonic
+// clock that hands out a cached time point. The owner refreshes it at 
+// convenient moments, so reading it costs a single relaxed atomic load
+// instead of a clock read.
+class CoarseClock
+{
+public:
+	using clock_type = std::chrono::steady_clock;
+
+	CoarseClock();
+	virtual ~CoarseClock() = default;
+
+	CoarseClock(const CoarseClock & rhs) = delete;
+	CoarseClock & operator =(const CoarseClock & rhs) = delete;
+
+	// Returns the cached time.
+	clock_type::time_point Now() const;
+
+	// Reads steady_clock, caches and returns the result.
+	clock_type::time_point Update();
+
+	// Caches a time that has just been read from steady_clock.
+	void Update(clock_type::time_point now);
+
+private:
+	std::atomic<clock_type::rep> m_now;
+};
+
+// Class TimerWheel definition and its members declaration. A hashed timing
+// wheel driven by a single steady_timer. Scheduling and cancelling an entry
+// are O(1) list operations, and one tick of the underlying timer expires
+// every entry that falls into the current slot. The timer only runs while
+// entries are scheduled.
+class TimerWheel
+{
+public:
+	// Intrusive hook embedded in the objects that use the wheel. The 
+	// callback is invoked without any lock held, from the thread running
+	// the tick, and should only post the real work to its owner.
+	class Entry
+	{
+		friend class TimerWheel;
+
+	public:
+		Entry() = default;
+
+		Entry(const Entry & rhs) = delete;
+		Entry & operator =(const Entry & rhs) = delete;
+
+		// Sets the function invoked when the entry expires. Must not be
+		// called while the entry is scheduled.
+		void SetCallback(std::function<void()> callback);
+
+		// Returns true if a callback has been set.
+		bool HasCallback() const;
+
+	private:
+		// Shared, so that collecting an expired entry does not copy the
+		// function and its captures
+		std::shared_ptr<const std::function<void()> > m_callback;
+		// Object kept alive while the entry is scheduled
+		std::shared_ptr<void> m_owner;
+		Entry *m_prev{nullptr};
+		Entry *m_next{nullptr};
+		size_t m_slot{0};
+		size_t m_rounds{0};
+		bool m_scheduled{false};
+	};
+
+	// The wheel refreshes clock on every tick and when it starts ticking,
+	// and reads the cached time when scheduling, so the owner keeps it 
+	// fresh in between as Hive::Run does.
+	TimerWheel(
+        boost::asio::io_context &io_context,
+        CoarseClock &clock,
+        std::chrono::milliseconds tick = std::chrono::milliseconds(10),
+        size_t slot_count = 512
+    );
+	virtual ~TimerWheel() = default;
+
+	TimerWheel(const TimerWheel & rhs) = delete;
+	TimerWheel & operator =(const TimerWheel & rhs) = delete;
+
+	// Schedules the entry to expire after delay, rounded up to the tick 
+	// resolution. An entry that is already scheduled is moved. owner, 
+	// typically the object the entry is embedded in, is kept alive until
+	// the entry is cancelled or its callback has returned, and is released
+	// without any lock held.
+	void Schedule(Entry &entry, std::chrono::milliseconds delay, std::shared_ptr<void> owner = nullptr);
+
+	// Removes the entry from the wheel without invoking its callback.
+	void Cancel(Entry &entry);
+
+	// Expires every scheduled entry right away and stops ticking. Entries
+	// scheduled afterwards expire immediately until Reset is called.
+	void Stop();
+
+	// Allows the wheel to tick again after Stop has been called.
+	void Reset();
+
+private:
+	void StartTick();
+	void HandleTick(const boost::system::error_code &error);
+	void Link(Entry &entry, size_t ticks, std::shared_ptr<void> &&owner);
+	std::shared_ptr<void> Unlink(Entry &entry);
+
+	// Callback of an expired entry and the owner it keeps alive
+	struct Expired
+	{
+		std::shared_ptr<const std::function<void()> > m_callback;
+		std::shared_ptr<void> m_owner;
+	};
+
+private:
+	boost::asio::steady_timer m_timer;
+
+	// A cancelled wait is only destroyed with the io_context, after the 
+	// wheel, so the handler keeps the memory it lives in alive
+	std::shared_ptr<HandlerMemory> m_handler_memory{std::make_shared<HandlerMemory>()};
+	CoarseClock &m_clock;
+	std::chrono::steady_clock::duration m_tick;
+	std::chrono::steady_clock::time_point m_next_tick;
+	std::vector<Entry *> m_slots;
+	std::vector<Expired> m_expired;
+	std::mutex m_mutex;
+	size_t m_current_slot{0};
+	size_t m_scheduled_count{0};
+	bool m_ticking{false};
+	bool m_stopped{false};
+};
+
+// Class ResolverCache definition and its members declaration. Resolves 
+// host names asynchronously and keeps the results for a time to live, so
+// that repeated connections to the same host do not wait for DNS. Lookups
+// of the same name that overlap share one query, and numeric addresses
+// never go through the resolver.
+class ResolverCache
+{
+public:
+	using endpoints_type = std::vector<boost::asio::ip::tcp::endpoint>;
+	using handler_type = std::function<void(
+        const boost::system::error_code &,
+        std::shared_ptr<const endpoints_type>
+    )>;
+
+	explicit ResolverCache(
+        boost::asio::io_context &io_context,
+        std::chrono::seconds time_to_live = std::chrono::seconds(60)
+    );
+	virtual ~ResolverCache() = default;
+
+	ResolverCache(const ResolverCache & rhs) = delete;
+	ResolverCache & operator =(const ResolverCache & rhs) = delete;
+
+	// Resolves host and port. The handler is never invoked from within 
+	// Resolve; it runs on a thread running the io_context, so callers post
+	// to their strand from it.
+	void Resolve(const std::string &host, uint16_t port, handler_type handler);
+
+	// Sets how long successful lookups are kept. The default value is 60 s.
+	void SetTimeToLive(std::chrono::seconds time_to_live);
+
+	// Removes every cached result.
+	void Clear();
+
+private:
+	struct Entry
+	{
+		std::shared_ptr<const endpoints_type> m_endpoints;
+		std::chrono::steady_clock::time_point m_expires;
+		std::vector<handler_type> m_waiters;
+		bool m_resolving{false};
+	};
+
+	void HandleResolve(
+        const std::string &key,
+        const boost::system::error_code &error,
+        const boost::asio::ip::tcp::resolver::results_type &results
+    );
+
+private:
+	boost::asio::io_context &m_io_context;
+	std::mutex m_mutex;
+	std::unordered_map<std::string, Entry> m_entries;
+	std::chrono::seconds m_time_to_live;
+};
 
 // Class Hive definition and its members declaration
 class Hive : public std::enable_shared_from_this<Hive>
 {
 public:
+	// Per-object serializer used by Acceptor and Connection. Every instance
+	// owns its own implementation, unlike io_context::strand which hashes
+	// objects into a fixed set of shared implementations, so a handler that
+	// blocks only holds up its own object. Each handler costs a little more
+	// to run; strandbench measures both cases.
+	using strand_type = boost::asio::strand<boost::asio::io_context::executor_type>;
+
 	Hive() = default;
+	// Creates the io_context with a concurrency hint. Use 1 when the object
+	// is going to be run by exactly one thread.
+	explicit Hive(int concurrency_hint);
 	virtual ~Hive() = default;
 
 	Hive(const Hive & rhs) = delete;
@@ -31,6 +508,23 @@ public:
 	// Returns the io_context of this object.
 	boost::asio::io_context& GetContext();
 
+	// Returns the pool the receive and send buffers of the connections of
+	// this object are leased from.
+	BufferPool& GetBufferPool();
+
+	// Returns the timing wheel that drives the timers of the Acceptor and
+	// Connection objects of this object.
+	TimerWheel& GetTimerWheel();
+
+	// Returns the DNS cache used by Acceptor::Listen and Connection::Connect.
+	ResolverCache& GetResolverCache();
+
+	// Returns the cached monotonic time of this object. It is refreshed 
+	// once per event loop iteration of Run and Poll and on every tick of
+	// the timing wheel, so it lags behind steady_clock by at most a tick
+	// while timers are scheduled.
+	CoarseClock::clock_type::time_point GetTime() const;
+
 	// Returns true if the Stop function has been called.
 	bool HasStopped();
 
@@ -41,32 +535,222 @@ public:
 	// Runs the networking system on the current thread. This function blocks 
 	// until the networking system is stopped, so do not call on a single 
 	// threaded application with no other means of being able to call Stop 
-	// unless you code in such logic.
+	// unless you code in such logic. Prefer this over running the io_context
+	// directly, as it keeps the cached time returned by GetTime fresh.
 	void Run();
 
-	// Stops the networking system. All work is finished and no more 
-	// networking interactions will be possible afterwards until Reset is called.
+	// Stops the networking system. The threads running Run finish the 
+	// handlers queued before the call and then return, even if operations
+	// are still outstanding; join them before calling Reset. The last one
+	// to return also runs the completions that are ready by then, such as
+	// those of the connections closed by the shutdown. A Hive driven by 
+	// Poll stops on the next call. This function does not wait and never
+	// runs handlers itself. No more networking interactions will be 
+	// possible afterwards until Reset is called.
 	void Stop();
 
 	// Restarts the networking system after Stop as been called. A new work
 	// object is created ad the shutdown flag is cleared.
 	void Reset();
 
+private:
+	void Drain();
+
 private:
     boost::asio::io_context m_io_context;
+    BufferPool m_buffer_pool;
+    CoarseClock m_clock;
+    TimerWheel m_timer_wheel{m_io_context, m_clock};
+    ResolverCache m_resolver_cache{m_io_context};
     using work_type = boost::asio::executor_work_guard<boost::asio::io_context::executor_type>;
     std::unique_ptr<work_type> m_work_ptr{std::make_unique<work_type>(boost::asio::make_work_guard(m_io_context))};
     std::atomic<bool> m_shutdown{false};
+    // Threads inside Run, the last one to return drains the io_context
+    std::atomic<size_t> m_runners{0};
+};
+
+// Class HivePool definition and its members declaration. The pool owns
+// several Hive objects and runs each of them on its own thread, so every
+// io_context has a single reactor queue that is never contended by other
+// threads. New connections should be created on GetNextHive() to spread
+// them across the threads.
+class HivePool
+{
+public:
+	// Thread function used by Run. It receives the Hive the thread is
+	// bound to and a 1-based thread counter, and must return once the Hive
+	// has been stopped.
+	using worker_type = std::function<void(std::shared_ptr<Hive>, size_t)>;
+
+	// Creates hive_count Hive objects. A value of 0 uses the number of
+	// hardware threads.
+	explicit HivePool(size_t hive_count = 0);
+	virtual ~HivePool();
+
+	HivePool(const HivePool & rhs) = delete;
+	HivePool & operator =(const HivePool & rhs) = delete;
+
+	// Returns the number of Hive objects in the pool.
+	size_t GetSize() const;
+
+	// Returns the Hive object at index.
+	std::shared_ptr<Hive> GetHive(size_t index);
+
+	// Returns the next Hive object in round-robin order. This function is
+	// thread safe.
+	std::shared_ptr<Hive> GetNextHive();
+
+	// Starts one thread per Hive object. If worker is empty, each thread
+	// simply calls Hive::Run.
+	void Run(worker_type worker = worker_type());
+
+	// Stops every Hive object on the thread that runs it and joins the
+	// threads started by Run once they have finished the remaining work.
+	void Stop();
+
+	// Restarts every Hive object after Stop has been called.
+	void Reset();
+
+private:
+	std::vector<std::shared_ptr<Hive> > m_hives;
+	std::vector<std::thread> m_threads;
+	std::atomic<size_t> m_next_hive{0};
+};
+
+// Class PlainAtomic definition. The part of the std::atomic interface 
+// that Acceptor and Connection use, as a plain value for objects that are
+// only ever touched by one thread. The memory orders are ignored.
+template<class T>
+class PlainAtomic
+{
+public:
+	constexpr PlainAtomic(T value = T()) :
+        m_value(value)
+	{}
+
+	PlainAtomic(const PlainAtomic & rhs) = delete;
+	PlainAtomic & operator =(const PlainAtomic & rhs) = delete;
+
+	T operator =(T value)
+	{
+		return m_value = value;
+	}
+
+	operator T() const
+	{
+		return m_value;
+	}
+
+	T load(std::memory_order = std::memory_order_seq_cst) const
+	{
+		return m_value;
+	}
+
+	void store(T value, std::memory_order = std::memory_order_seq_cst)
+	{
+		m_value = value;
+	}
+
+	T fetch_add(T value, std::memory_order = std::memory_order_seq_cst)
+	{
+		T previous = m_value;
+		m_value += value;
+		return previous;
+	}
+
+	T fetch_sub(T value, std::memory_order = std::memory_order_seq_cst)
+	{
+		T previous = m_value;
+		m_value -= value;
+		return previous;
+	}
+
+	bool compare_exchange_weak(T &expected, T desired, std::memory_order = std::memory_order_seq_cst)
+	{
+		if (m_value != expected)
+		{
+			expected = m_value;
+			return false;
+		}
+		m_value = desired;
+		return true;
+	}
+
+private:
+	T m_value;
+};
+
+// Struct MultiThreaded definition. Threading policy of BasicAcceptor and
+// BasicConnection for a Hive run by any number of threads. The handlers of
+// every object are serialized by its own strand, the flags shared with 
+// other threads are atomic, and Send and Recv post to the strand so that
+// they can be called from any thread.
+struct MultiThreaded
+{
+	using executor_type = Hive::strand_type;
+	template<class T> using atomic_type = std::atomic<T>;
+	template<class T> using queue_type = RingQueue<T>;
+
+	// Send and Recv post every call through the strand, so they may be
+	// called from any thread
+	static constexpr bool direct_calls = false;
+
+	// Limits of a single gathered write. At least one buffer is always
+	// written, even if it is larger than max_send_bytes.
+	static constexpr size_t max_send_buffers = 64;
+	static constexpr size_t max_send_bytes = 256 * 1024;
+
+	// Default value of SetReceiveBufferSize
+	static constexpr int32_t receive_buffer_size = 4096;
+
+	static executor_type MakeExecutor(boost::asio::io_context &io_context)
+	{
+		return boost::asio::make_strand(io_context);
+	}
 };
 
-// Class Acceptor definition and its members declaration
-class Acceptor : public std::enable_shared_from_this<Acceptor>
+// Struct SingleThreaded definition. Threading policy for a Hive run by 
+// exactly one thread, as with HivePool, where every object is only ever
+// used from that thread. The handlers run on the io_context's executor 
+// without a strand, the flags are plain values, and Send and Recv queue 
+// the data right away. Such objects must not be used from other threads.
+struct SingleThreaded
+{
+	using executor_type = boost::asio::io_context::executor_type;
+	template<class T> using atomic_type = PlainAtomic<T>;
+	template<class T> using queue_type = RingQueue<T>;
+
+	static constexpr bool direct_calls = true;
+	static constexpr size_t max_send_buffers = 64;
+	static constexpr size_t max_send_bytes = 256 * 1024;
+	static constexpr int32_t receive_buffer_size = 4096;
+
+	static executor_type MakeExecutor(boost::asio::io_context &io_context)
+	{
+		return io_context.get_executor();
+	}
+};
+
+// The classes the library is built around, which may be used from any 
+// thread.
+using Acceptor = BasicAcceptor<MultiThreaded>;
+using Connection = BasicConnection<MultiThreaded>;
+
+// Class BasicAcceptor definition and its members declaration. The member
+// functions are defined in wrapper.cpp and instantiated there for 
+// MultiThreaded and SingleThreaded. The Acceptor creates and accepts 
+// connections of the same policy.
+template<class Policy>
+class BasicAcceptor : public std::enable_shared_from_this<BasicAcceptor<Policy> >
 {
 	friend class Hive;
 
 public:
-    Acceptor(const Acceptor &rhs) = delete;
-    Acceptor& operator=(const Acceptor &rhs) = delete;
+	using executor_type = typename Policy::executor_type;
+	using connection_type = BasicConnection<Policy>;
+
+    BasicAcceptor(const BasicAcceptor &rhs) = delete;
+    BasicAcceptor& operator=(const BasicAcceptor &rhs) = delete;
 
 	// Returns the Hive object.
 	std::shared_ptr<Hive> GetHive();
@@ -74,8 +758,9 @@ public:
 	// Returns the acceptor object.
 	boost::asio::ip::tcp::acceptor &GetAcceptor();
 
-	// Returns the strand object.
-	boost::asio::io_context::strand &GetStrand();
+	// Returns the strand object, or with SingleThreaded the executor of the
+	// io_context.
+	executor_type &GetStrand();
 
 	// Sets the timer interval of the object. The interval is changed after 
 	// the next update is called. The default value is 1000 ms.
@@ -87,34 +772,71 @@ public:
 	// Returns true if this object has an error associated with it.
 	bool HasError();
 
-	// Begin listening on the specific network interface.
+	// Sets the number of accepts that Accept() keeps outstanding on the 
+	// listening socket. The default value is 1.
+	void SetPendingAccepts(int32_t pending_accepts);
+
+	// Returns the number of accepts that Accept() keeps outstanding.
+	int32_t GetPendingAccepts() const;
+
+	// Sets whether Listen enables SO_REUSEPORT on the listening socket. 
+	// Several Acceptor objects, typically one per Hive of a HivePool, can 
+	// then listen on the same address and the kernel distributes the new 
+	// connections between them. Must be called before Listen. The default
+	// value is false.
+	void SetReusePort(bool reuse_port);
+
+	// Returns true if Listen enables SO_REUSEPORT.
+	bool GetReusePort() const;
+
+	// Begin listening on the specific network interface. Numeric addresses
+	// are bound right away and errors are thrown. Host names are resolved
+	// asynchronously; errors are then reported through OnError, and accepts
+	// posted in the meantime wait for the listening socket.
 	void Listen(const std::string &host, const uint16_t &port);
 
 	// Posts the connection to the listening interface. The next client that
 	// connections will be given this connection. If multiple calls to Accept
 	// are called at a time, then they are accepted in a FIFO order.
-	void Accept(std::shared_ptr<Connection> connection);
+	void Accept(std::shared_ptr<connection_type> connection);
+
+	// Keeps GetPendingAccepts() accepts outstanding with connections 
+	// obtained from CreateConnection. Every completed accept is replaced by
+	// a new one until the acceptor is closed or CreateConnection returns
+	// nullptr.
+	void Accept();
 
 	// Stop the Acceptor from listening.
 	void Stop();
 
 protected:
-	Acceptor(std::shared_ptr<Hive> hive);
-	virtual ~Acceptor() = default;
+	BasicAcceptor(std::shared_ptr<Hive> hive);
+	virtual ~BasicAcceptor();
+
+	// Called by Accept() to create the connections it keeps outstanding. 
+	// The default implementation returns nullptr, which stops the refill.
+	virtual std::shared_ptr<connection_type> CreateConnection();
 
 private:
+	void StartListen(const boost::asio::ip::tcp::endpoint &endpoint);
 	void StartTimer();
 	void StartError(const boost::system::error_code & error);
-	void DispatchAccept(std::shared_ptr<Connection> connection);
+	void DispatchAccept(std::shared_ptr<connection_type> connection);
+	void DispatchRefill();
+	void DispatchAcceptDone();
+	void HandleResolve(
+        const boost::system::error_code & error,
+        std::shared_ptr<const ResolverCache::endpoints_type> endpoints
+    );
 	void HandleTimer(const boost::system::error_code & error);
-	void HandleAccept(const boost::system::error_code & error, std::shared_ptr<Connection> connection);
+	void HandleAccept(const boost::system::error_code & error, std::shared_ptr<connection_type> connection);
 	// Called when a connection has connected to the server. This function 
 	// should return true to invoke the connection's OnAccept function if the 
 	// connection will be kept. If the connection will not be kept, the 
 	// connection's Disconnect function should be called and the function 
 	// should return false.
 	virtual bool OnAccept(
-        std::shared_ptr<Connection> connection,
+        std::shared_ptr<connection_type> connection,
         const std::string &host,
         uint16_t port
     ) = 0;
@@ -130,22 +852,40 @@ private:
 private:
 	std::shared_ptr<Hive> m_hive;
 	boost::asio::ip::tcp::acceptor m_acceptor;
-	boost::asio::io_context::strand m_io_strand;
-	boost::asio::deadline_timer m_timer;
-	boost::posix_time::ptime m_last_time;
+	executor_type m_io_strand;
+	HandlerMemory m_handler_memory;
+	TimerWheel::Entry m_timer_entry;
+	CoarseClock::clock_type::time_point m_last_time;
     int32_t m_timer_interval{1000};
-    std::atomic<bool> m_error_state{false};
+    int32_t m_pending_accepts{1};
+    int32_t m_outstanding_accepts{0};
+    bool m_refill_accepts{false};
+    bool m_reuse_port{false};
+    bool m_resolving{false};
+    std::vector<std::shared_ptr<connection_type> > m_queued_accepts;
+    typename Policy::template atomic_type<bool> m_error_state{false};
 };
 
-// Class Connection definition and its members declaration
-class Connection : public std::enable_shared_from_this<Connection>
+// Class BasicConnection definition and its members declaration. The 
+// member functions are defined in wrapper.cpp and instantiated there for
+// MultiThreaded and SingleThreaded.
+template<class Policy>
+class BasicConnection : public std::enable_shared_from_this<BasicConnection<Policy> >
 {
-	friend class Acceptor;
+	template<class> friend class BasicAcceptor;
 	friend class Hive;
+	template<class T> friend class ConnectionPool;
+	friend class ConnectionGroup;
+	friend class FramedConnection;
+	friend class DelimitedConnection;
+	friend class HttpClientConnection;
+	friend class HttpServerConnection;
 
 public:
-	Connection(const Connection &rhs) = delete;
-	Connection& operator=(const Connection &rhs) = delete;
+	using executor_type = typename Policy::executor_type;
+
+	BasicConnection(const BasicConnection &rhs) = delete;
+	BasicConnection& operator=(const BasicConnection &rhs) = delete;
 
 	// Returns the Hive object.
 	std::shared_ptr<Hive> GetHive();
@@ -153,8 +893,9 @@ public:
 	// Returns the socket object.
 	boost::asio::ip::tcp::socket &GetSocket();
 
-	// Returns the strand object.
-	boost::asio::io_context::strand &GetStrand();
+	// Returns the strand object, or with SingleThreaded the executor of the
+	// io_context.
+	executor_type &GetStrand();
 
 	// Sets the application specific receive buffer size used. For stream 
 	// based protocols such as HTTP, you want this to be pretty large, like 
@@ -179,38 +920,162 @@ public:
 	// Binds the socket to the specified interface.
 	void Bind(const std::string &ip, uint16_t port);
 
-	// Starts an a/synchronous connect.
+	// Starts an asynchronous connect. The host is resolved through the 
+	// Hive's ResolverCache and every resolved endpoint is tried in order 
+	// until one of them accepts the connection.
 	void Connect(const std::string &host, uint16_t port);
 
-	// Posts data to be sent to the connection.
-	void Send(const std::vector<uint8_t> &buffer);
+	// Posts data to be sent to the connection. Every Send overload returns
+	// the number of bytes queued on the connection, this buffer included,
+	// so that producers can hold back while the peer does not keep up. 
+	// With SingleThreaded the data is queued right away instead of posted.
+	size_t Send(const std::vector<uint8_t> &buffer);
+
+	// Posts data to be sent to the connection with move semantics. The 
+	// buffer is given to the Hive's BufferPool once it has been sent, so
+	// buffers acquired from the pool (such as the one passed to OnRecv) are
+	// recycled.
+	size_t Send(std::vector<uint8_t> &&buffer);
+
+	// Posts a shared buffer to be sent to the connection without copying 
+	// it. The cost does not depend on the size of the buffer, so the same
+	// payload can be broadcast to any number of connections. OnSend is 
+	// called with the shared buffer once it has been sent.
+	size_t Send(SharedBuffer buffer);
+
+	// Returns the number of bytes passed to Send that have not been 
+	// written to the socket yet.
+	size_t GetQueuedSendBytes() const;
+
+	// Sets the send queue watermarks in bytes. OnWriteBlocked is called 
+	// when the queued bytes reach high, and OnDrain when they have fallen
+	// back to low afterwards. The defaults are 256kb and 1mb. Throws 
+	// boost::system::system_error with errc::invalid_argument if low is 
+	// greater than high.
+	void SetSendWatermarks(size_t low, size_t high);
+
+	// Returns the low watermark of the send queue.
+	size_t GetSendLowWatermark() const;
+
+	// Returns the high watermark of the send queue.
+	size_t GetSendHighWatermark() const;
 
-	// Posts data to be sent to the connection with move semantics.
-	void Send(std::vector<uint8_t> &&buffer);
+	// Sets how long the send queue may stay blocked, from reaching the high
+	// watermark until falling back to the low one, before the connection 
+	// is closed with boost::asio::error::timed_out. It is checked on each
+	// timer event. The default of 0 never closes the connection.
+	void SetSlowConsumerTimeout(int32_t timeout_ms);
+
+	// Returns the slow consumer timeout of the object.
+	int32_t GetSlowConsumerTimeout() const;
 
 	// Posts a recv for the connection to process. If total_bytes is 0, then 
 	// as many bytes as possible up to GetReceiveBufferSize() will be 
 	// waited for. If Recv is not 0, then the connection will wait for exactly
-	// total_bytes before invoking OnRecv.
+	// total_bytes before invoking OnRecv. With SingleThreaded the receive 
+	// is queued right away instead of posted.
 	void Recv(int32_t total_bytes = 0);
 
+	// Sets whether the connection keeps reading on its own. When enabled,
+	// the next read of up to GetReceiveBufferSize() bytes is started right
+	// after OnRecv returns, unless another Recv is already pending, so 
+	// OnRecv does not have to call Recv and no post is needed per read.
+	// Call Recv once to start reading. It is disabled by default.
+	void SetContinuousRecv(bool continuous);
+
+	// Returns true if the connection keeps reading on its own.
+	bool IsContinuousRecv() const;
+
+	// Stops starting new reads, so that the peer is eventually held back by
+	// TCP flow control. A read that is already in progress completes and is
+	// passed to OnRecv. This function is thread safe.
+	void PauseRecv();
+
+	// Resumes reading after PauseRecv. This function is thread safe.
+	void ResumeRecv();
+
+	// Returns true if reading has been paused.
+	bool IsRecvPaused() const;
+
 	// Posts an asynchronous disconnect event for the object to process.
 	void Disconnect();
 
+#if defined(BOOST_ASIO_HAS_CO_AWAIT)
+	// Coroutine interface. Spawn the coroutine on the strand of the 
+	// connection, co_spawn(connection->GetStrand(), ...), so that it is 
+	// serialized with the timer and the other handlers of the object. The 
+	// operations work on the socket directly and do not go through the 
+	// Send and Recv queues or the OnConnect, OnSend and OnRecv callbacks, 
+	// so a connection is driven either by coroutines or by callbacks. 
+	// Errors are thrown as boost::system::system_error; call Disconnect to
+	// close the connection afterwards.
+
+	// Resolves the host through the Hive's ResolverCache and connects to 
+	// the first resolved endpoint that accepts the connection. The 
+	// coroutine counterpart of Connect, which OnConnect reports to.
+	boost::asio::awaitable<void> AsyncConnect(std::string host, uint16_t port);
+
+	// Reads at least one byte into buffer and returns the number of bytes
+	// read.
+	boost::asio::awaitable<size_t> ReadSome(boost::asio::mutable_buffer buffer);
+
+	// Reads exactly total_bytes bytes into a buffer leased from the Hive's
+	// BufferPool. Pass it to Send or back to the pool once done with it.
+	boost::asio::awaitable<std::vector<uint8_t> > ReadExactly(size_t total_bytes);
+
+	// Writes every byte of buffers, a ConstBufferSequence whose underlying
+	// memory must stay valid until the returned awaitable completes, and 
+	// returns the number of bytes written. The sequence itself is copied.
+	template<class ConstBufferSequence>
+	boost::asio::awaitable<size_t> Write(ConstBufferSequence buffers)
+	{
+		auto self = this->shared_from_this();
+		co_return co_await boost::asio::async_write(m_socket, buffers, boost::asio::use_awaitable);
+	}
+#endif
+
 protected:
-	Connection(std::shared_ptr<Hive> hive);
-	virtual ~Connection() = default;
+	BasicConnection(std::shared_ptr<Hive> hive);
+	virtual ~BasicConnection();
+
+	// Called from OnRecv to keep count bytes of the buffer, starting at 
+	// offset, typically an incomplete message. The next receive reads right
+	// behind them, and OnRecv then finds them at GetRecvOffset() followed by
+	// the new bytes. They are only moved to the front of the buffer once the
+	// bytes before them outgrow the receive buffer size. The buffer must not
+	// be moved out of OnRecv when bytes are kept.
+	void KeepRecv(size_t offset, size_t count);
+
+	// Returns the position in the buffer passed to OnRecv of the first byte
+	// that has not been consumed yet. It is 0 unless KeepRecv was called 
+	// from the previous OnRecv.
+	size_t GetRecvOffset() const;
 
 private:
+	struct PendingSend;
+	class StrandRef;
+
+	void Reset();
 	void StartSend();
 	void StartRecv(int32_t total_bytes);
 	void StartTimer();
 	void StartError(const boost::system::error_code &error);
 	void DispatchSend(std::vector<uint8_t> &&buffer);
+	void DispatchSend(SharedBuffer &&buffer);
+	void EnqueueSend(PendingSend &&pending);
+	void ReleaseSends();
 	void DispatchRecv(int32_t total_bytes);
-	void DispatchTimer(const boost::system::error_code &error);
-	void HandleConnect(const boost::system::error_code &error);
-	void HandleSend(const boost::system::error_code &error, std::list<std::vector<uint8_t> >::iterator itr);
+	void DispatchResumeRecv();
+	void StartNextRecv();
+	void DispatchTimer(std::shared_ptr<BasicConnection> &&self);
+	void StartConnect(size_t endpoint_index);
+	void ReopenSocket(boost::system::error_code &ec);
+	void HandleResolve(
+        const boost::system::error_code &error,
+        std::shared_ptr<const ResolverCache::endpoints_type> endpoints
+    );
+	void HandleConnect(const boost::system::error_code &error, size_t endpoint_index);
+	void HandleSend(const boost::system::error_code &error, size_t buffer_count);
 	void HandleRecv(const boost::system::error_code &error, int32_t actual_bytes );
 	void HandleTimer(const boost::system::error_code &error);
 
@@ -225,7 +1090,9 @@ private:
 	// Called when data has been sent by the connection.
 	virtual void OnSend(const std::vector<uint8_t> &buffer) = 0;
 
-	// Called when data has been received by the connection. 
+	// Called when data has been received by the connection. The buffer is
+	// leased from the Hive's BufferPool; it may be moved out, for instance
+	// into Send, in which case a new one is leased for the next receive.
 	virtual void OnRecv(std::vector<uint8_t> &buffer ) = 0;
 
 	// Called on each timer event.
@@ -234,17 +1101,363 @@ private:
 	// Called when an error is encountered.
 	virtual void OnError(const boost::system::error_code &error) = 0;
 
+	// Called when the queued send bytes reach the high watermark. Stop 
+	// producing data for the connection until OnDrain is called.
+	virtual void OnWriteBlocked();
+
+	// Called when the queued send bytes have fallen back to the low 
+	// watermark after OnWriteBlocked.
+	virtual void OnDrain();
+
+	// Called when the connection is recycled by a ConnectionPool, after the
+	// socket has been closed and the queues have been cleared. Derived 
+	// classes reset their own state here.
+	virtual void OnReset();
+
 private:
+	// Struct Connection::PendingSend definition. An entry of the send queue,
+	// either a buffer owned by the connection, which goes back to the 
+	// BufferPool once sent, or a reference to a shared buffer.
+	struct PendingSend
+	{
+		std::vector<uint8_t> m_owned;
+		SharedBuffer m_shared;
+
+		const std::vector<uint8_t> &Get() const
+		{
+			return m_shared ? *m_shared : m_owned;
+		}
+	};
+
+	// Class Connection::StrandRef definition. Keeps the connection alive
+	// for a handler that runs on its strand. The references are counted on
+	// the strand without atomics and only the first one takes a shared_ptr,
+	// so a read or write that starts the next one does not touch the 
+	// shared_ptr control block. Create and destroy it on the strand only.
+	class StrandRef
+	{
+	public:
+		explicit StrandRef(BasicConnection *connection);
+		StrandRef(StrandRef &&rhs) noexcept;
+		StrandRef(const StrandRef &rhs) = delete;
+		StrandRef& operator=(const StrandRef &rhs) = delete;
+		~StrandRef();
+
+		BasicConnection *operator->() const
+		{
+			return m_connection;
+		}
+
+	private:
+		BasicConnection *m_connection;
+	};
+
     std::shared_ptr<Hive> m_hive;
 	boost::asio::ip::tcp::socket m_socket;
-	boost::asio::io_context::strand m_io_strand;
-	boost::asio::deadline_timer m_timer;
-	boost::posix_time::ptime m_last_time;
+	executor_type m_io_strand;
+	HandlerMemory m_handler_memory;
+	std::shared_ptr<BasicConnection> m_strand_owner;
+	size_t m_strand_refs{0};
+	TimerWheel::Entry m_timer_entry;
+	CoarseClock::clock_type::time_point m_last_time;
 	std::vector<uint8_t> m_recv_buffer;
-	std::list<int32_t> m_pending_recvs;
-	std::list<std::vector<uint8_t> > m_pending_sends;
-	int32_t m_receive_buffer_size{4096};
+	typename Policy::template queue_type<int32_t> m_pending_recvs;
+	typename Policy::template queue_type<PendingSend> m_pending_sends;
+	std::vector<boost::asio::const_buffer> m_send_buffers;
+	std::shared_ptr<const ResolverCache::endpoints_type> m_connect_endpoints;
+	std::optional<boost::asio::ip::tcp::endpoint> m_bind_endpoint;
+	size_t m_recv_offset{0};
+	size_t m_recv_keep_begin{0};
+	size_t m_recv_keep_end{0};
+	int32_t m_receive_buffer_size{Policy::receive_buffer_size};
 	int32_t m_timer_interval{1000};
-	std::atomic<bool> m_error_state{false};
+	typename Policy::template atomic_type<size_t> m_queued_send_bytes{0};
+	size_t m_send_low_watermark{256 * 1024};
+	size_t m_send_high_watermark{1024 * 1024};
+	int32_t m_slow_consumer_timeout{0};
+	CoarseClock::clock_type::time_point m_write_blocked_time;
+	bool m_write_blocked{false};
+	bool m_continuous_recv{false};
+	bool m_recv_stalled{false};
+	typename Policy::template atomic_type<bool> m_recv_paused{false};
+	typename Policy::template atomic_type<bool> m_error_state{false};
+};
+
+// Class ConnectionPool definition. Recycles connections of type T, which
+// must be constructible from a std::shared_ptr<Hive>. When the last 
+// reference to a connection returned by Acquire goes away, the connection
+// is reset and kept for the next Acquire instead of being destroyed: the
+// socket is closed, while the buffers and queues keep their capacity.
+// The pool itself must be owned by a std::shared_ptr.
+template<class T>
+class ConnectionPool : public std::enable_shared_from_this<ConnectionPool<T> >
+{
+public:
+	explicit ConnectionPool(std::shared_ptr<Hive> hive, size_t max_pooled = 1024) :
+        m_hive(std::move(hive)),
+        m_max_pooled(max_pooled)
+	{
+		m_free_connections.reserve(m_max_pooled);
+	}
+
+	virtual ~ConnectionPool()
+	{
+		for (auto &&connection : m_free_connections)
+			delete connection;
+	}
+
+	ConnectionPool(const ConnectionPool & rhs) = delete;
+	ConnectionPool & operator =(const ConnectionPool & rhs) = delete;
+
+	// Returns the Hive object the connections are created on.
+	std::shared_ptr<Hive> GetHive()
+	{
+		return m_hive;
+	}
+
+	// Returns a recycled connection, or a new one if the pool is empty. 
+	// This function is thread safe.
+	std::shared_ptr<T> Acquire()
+	{
+		T *connection = nullptr;
+		{
+			std::lock_guard lck(m_mutex);
+			if (!m_free_connections.empty())
+			{
+				connection = m_free_connections.back();
+				m_free_connections.pop_back();
+			}
+		}
+		if (!connection)
+			connection = new T(m_hive);
+
+		return std::shared_ptr<T>(
+            connection,
+            [weak_pool=this->weak_from_this()](T *connection)
+            {
+                if (auto pool = weak_pool.lock())
+                    pool->Release(connection);
+                else
+                    delete connection;
+            }
+        );
+	}
+
+	// Returns the number of connections waiting to be reused.
+	size_t GetPooledCount()
+	{
+		std::lock_guard lck(m_mutex);
+		return m_free_connections.size();
+	}
+
+private:
+	void Release(T *connection)
+	{
+		connection->Reset();
+		{
+			std::lock_guard lck(m_mutex);
+			if (m_free_connections.size() < m_max_pooled)
+			{
+				m_free_connections.push_back(connection);
+				return;
+			}
+		}
+		delete connection;
+	}
+
+private:
+	std::shared_ptr<Hive> m_hive;
+	std::mutex m_mutex;
+	std::vector<T *> m_free_connections;
+	size_t m_max_pooled;
+};
+
+// Class ConnectionGroup definition and its members declaration. A set of
+// connections a message can be broadcast to, as in chat or publish and
+// subscribe servers. Members are kept per Hive in a bucket that is only 
+// accessed on its own strand, so adding or removing a member is O(1) and
+// a broadcast costs one post per Hive instead of one per member. On the 
+// Hive's thread the bucket then dispatches the send into the strand of 
+// every member, which runs inline whenever that strand is idle. Members
+// in error state are skipped and dropped from the group. This class is
+// thread safe.
+class ConnectionGroup
+{
+public:
+	ConnectionGroup() = default;
+	virtual ~ConnectionGroup() = default;
+
+	ConnectionGroup(const ConnectionGroup & rhs) = delete;
+	ConnectionGroup & operator =(const ConnectionGroup & rhs) = delete;
+
+	// Adds a connection to the group. Adding a member again has no effect.
+	void Add(std::shared_ptr<Connection> connection);
+
+	// Removes a connection from the group, if it is a member.
+	void Remove(const std::shared_ptr<Connection> &connection);
+
+	// Removes every member.
+	void Clear();
+
+	// Sends buffer to every member except the one given, which may be 
+	// null. The payload is shared by every member and never copied. Add,
+	// Remove and Broadcast take effect in call order for the members of a
+	// Hive.
+	void Broadcast(SharedBuffer buffer, const Connection *except = nullptr);
+
+	// Copies buffer once into a SharedBuffer and broadcasts it.
+	void Broadcast(const std::vector<uint8_t> &buffer, const Connection *except = nullptr);
+
+	// Returns the number of members. Add and Remove calls are counted once
+	// the Hive of the connection has processed them.
+	size_t GetSize() const;
+
+private:
+	// Struct ConnectionGroup::Bucket definition. The members of one Hive.
+	// m_positions maps a member to its index in m_members, so that a 
+	// member is removed by moving the last one into its slot.
+	struct Bucket
+	{
+		explicit Bucket(std::shared_ptr<Hive> hive);
+
+		void Insert(std::shared_ptr<Connection> &&connection);
+		void Erase(size_t index);
+		void Send(const SharedBuffer &buffer, const Connection *except);
+
+		std::shared_ptr<Hive> m_hive;
+		Hive::strand_type m_strand;
+		HandlerMemory m_handler_memory;
+		std::vector<std::shared_ptr<Connection> > m_members;
+		std::unordered_map<const Connection *, size_t> m_positions;
+		std::atomic<size_t> m_size{0};
+	};
+
+	std::shared_ptr<Bucket> GetBucket(const std::shared_ptr<Hive> &hive);
+
+private:
+	mutable std::mutex m_mutex;
+	std::unordered_map<const Hive *, std::shared_ptr<Bucket> > m_buckets;
+};
+
+// Class FramedConnection definition and its members declaration. Splits the
+// received stream into length-prefixed frames. The connection reads large 
+// chunks and hands every complete frame of a chunk to OnFrame as a view 
+// into the receive buffer, so a frame costs neither its own read nor a 
+// copy. The bytes of an incomplete frame stay in the buffer and the next 
+// read is appended to them. Call Recv() once, typically from OnAccept or 
+// OnConnect; the connection keeps receiving from then on. OnRecv is used
+// internally and cannot be overridden.
+class FramedConnection : public Connection
+{
+public:
+	// Encoding of the length that precedes every frame. The length counts 
+	// the payload only. varint is the unsigned LEB128 encoding used by 
+	// protocol buffers and ignores the byte order. A varint that does not
+	// fit into 64 bits is reported to OnError as 
+	// boost::asio::error::invalid_argument and closes the connection.
+	enum class HeaderType { uint8, uint16, uint32, varint };
+	enum class ByteOrder { big_endian, little_endian };
+
+	// Sets the encoding of the length prefix. The default value is uint32.
+	void SetHeaderType(HeaderType header_type);
+
+	// Returns the encoding of the length prefix.
+	HeaderType GetHeaderType() const;
+
+	// Sets the byte order of fixed size length prefixes. The default value
+	// is big_endian.
+	void SetByteOrder(ByteOrder byte_order);
+
+	// Returns the byte order of fixed size length prefixes.
+	ByteOrder GetByteOrder() const;
+
+	// Sets the largest payload accepted. A larger frame is reported to 
+	// OnError as boost::asio::error::message_size and closes the connection.
+	// The default value is 1 MiB.
+	void SetMaxFrameSize(size_t max_frame_size);
+
+	// Returns the largest payload accepted.
+	size_t GetMaxFrameSize() const;
+
+	// Sends payload as one frame. Throws boost::system::system_error with
+	// boost::asio::error::message_size, and sends nothing, if the payload is
+	// larger than the maximum frame size or than the length prefix can hold.
+	void SendFrame(boost::asio::const_buffer payload);
+
+protected:
+	FramedConnection(std::shared_ptr<Hive> hive);
+	~FramedConnection() override = default;
+
+private:
+	void OnRecv(std::vector<uint8_t> &buffer) final;
+
+	// Decodes the length prefix at the start of data. Returns the size of 
+	// the prefix, 0 if more bytes are needed, or malformed_header if the 
+	// prefix does not encode a 64 bit value.
+	size_t ParseHeader(const uint8_t *data, size_t size, uint64_t &length) const;
+
+	// Called for every complete frame, in the order of the stream. The view
+	// points into the receive buffer and is only valid until OnFrame 
+	// returns.
+	virtual void OnFrame(boost::asio::const_buffer frame) = 0;
+
+private:
+	static constexpr size_t malformed_header = std::numeric_limits<size_t>::max();
+
+	HeaderType m_header_type{HeaderType::uint32};
+	ByteOrder m_byte_order{ByteOrder::big_endian};
+	size_t m_max_frame_size{1024 * 1024};
 };
+
+// Class DelimitedConnection definition and its members declaration. Splits
+// the received stream into messages that end with a delimiter, such as 
+// "\n" for line protocols or "\r\n\r\n" for HTTP headers. Like 
+// FramedConnection it hands every complete message of a chunk to OnMessage
+// as a view into the receive buffer and keeps incomplete messages in place.
+// The search for the delimiter is vectorized and resumes where the 
+// previous chunk ended. Call Recv() once; the connection keeps receiving 
+// from then on. OnRecv is used internally and cannot be overridden.
+class DelimitedConnection : public Connection
+{
+public:
+	// Sets the delimiter, which may be any non-empty sequence of bytes. The
+	// default value is "\n".
+	void SetDelimiter(std::string_view delimiter);
+
+	// Returns the delimiter.
+	const std::string &GetDelimiter() const;
+
+	// Sets the largest message accepted, without the delimiter. A larger 
+	// message is reported to OnError as boost::asio::error::message_size 
+	// and closes the connection. The default value is 64 KiB.
+	void SetMaxMessageSize(size_t max_message_size);
+
+	// Returns the largest message accepted.
+	size_t GetMaxMessageSize() const;
+
+	// Returns the position of the first delimiter in data, or size if there
+	// is none. Uses AVX2 or SSE2 when the target supports them.
+	static size_t Find(const uint8_t *data, size_t size, std::string_view delimiter);
+
+protected:
+	DelimitedConnection(std::shared_ptr<Hive> hive);
+	~DelimitedConnection() override = default;
+
+private:
+	void OnRecv(std::vector<uint8_t> &buffer) final;
+	void OnReset() override;
+
+	// Called for every complete message, in the order of the stream. The 
+	// message does not include the delimiter. The view points into the 
+	// receive buffer and is only valid until OnMessage returns.
+	virtual void OnMessage(boost::asio::const_buffer message) = 0;
+
+private:
+	std::string m_delimiter{"\n"};
+	size_t m_max_message_size{64 * 1024};
+	// Bytes of the incomplete message that are known not to start a 
+	// delimiter
+	size_t m_scanned{0};
+};
+
 #endif // _WRAPPER_H_